@@ -1,91 +1,359 @@
 #include "algorithms.h"
+#include "checkpoint.h"
 #include "graph.h"
+#include "schedule-kernels.h"
+#include "static-algorithms.h"
 #include "test-suite-oracle.h"
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <set>
 #include <unistd.h>
+#include <unordered_map>
 #include <utility>
 
-std::unique_ptr<Graph> PFAST::run(const std::vector<uint32_t> &tests,
-                                  TestSuiteOracle *oracle) {
-  std::unique_ptr<Graph> r{std::make_unique<Graph>(tests)};
+static void check_restored(const CheckpointReader &reader) {
+  if (!reader.ok()) {
+    std::cerr << "The checkpoint file is truncated or corrupted." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Adds to g, over the positions of the tests, the edges of a graph over
+// their ids, as restored from a checkpoint.
+template <class G>
+static void add_edges(G &g, const Graph &edges,
+                      const std::vector<uint32_t> &tests) {
+  std::unordered_map<uint32_t, uint32_t> positions;
+
+  for (uint32_t i = 0; i < tests.size(); ++i)
+    positions[tests[i]] = i;
+  for (const auto &it : edges)
+    for (const uint32_t v : it.second)
+      g.add_edge(positions[it.first], positions[v]);
+}
 
+template <class G, class O>
+std::unique_ptr<Graph> BasicPFAST<G, O>::run(const std::vector<uint32_t> &tests,
+                                             TestSuiteOracle *suite) {
+  O *oracle{static_cast<O *>(suite)};
+  G r{(uint32_t)tests.size()};
+  std::map<uint64_t, Probe> probes;
+  uint32_t passed, i{0};
+
+  truncated = false;
   if (tests.size() == 0)
-    return r;
+    return std::make_unique<Graph>(tests);
 
-  for (uint32_t i = 0; i < tests.size() - 1; ++i) {
-    std::vector<uint32_t> schedule{tests};
-    schedule.erase(schedule.begin() + i);
+  if (checkpointer)
+    if (auto reader = checkpointer->restore("pfast", tests, oracle)) {
+      i = reader->get();
+      add_edges(r, reader->get_graph(), tests);
+      check_restored(*reader);
+    }
+  if (progress)
+    progress->describe("pfast", "test", nullptr);
+
+  // The dependents of different tests are searched independently, so up
+  // to window() of them are searched at once. A checkpoint waits for the
+  // probes in flight, so that it holds every dependent of the tests
+  // before i. Once a probe was dropped by the budget, the dependents of
+  // its test are partial and no checkpoint is saved anymore.
+  uint32_t first_unknown = tests.size();
+  while (i < tests.size() - 1 || !probes.empty()) {
+    bool due = checkpointer && checkpointer->due();
+    if (due && probes.empty() && first_unknown == tests.size()) {
+      CheckpointWriter writer{checkpointer->begin("pfast", tests, oracle)};
+      writer.put(i);
+      writer.put(r.to_graph(tests));
+      checkpointer->save(writer);
+      due = false;
+    }
 
-    std::vector<bool> results = oracle->run_tests(schedule);
-    auto first_false = std::find(results.begin(), results.end(), false);
+    if (!due && !truncated && i < tests.size() - 1 &&
+        probes.size() < oracle->window()) {
+      if ((truncated = oracle->exhausted()))
+        continue;
+      Probe probe{i, ScheduleView{tests}};
+      probe.schedule.exclude(i);
+      uint64_t ticket = oracle->submit(probe.schedule);
+      probes.emplace(ticket, std::move(probe));
+      ++i;
+      if (progress)
+        progress->publish(0, i);
+      continue;
+    }
 
-    while (first_false != results.end()) {
-      r->add_edge(schedule[first_false - results.begin()], tests[i]);
-      if (first_false == results.end() - 1)
-        break;
-      schedule.erase(schedule.begin() + (first_false - results.begin()));
-      results = oracle->run_tests(schedule);
-      first_false = std::find(results.begin(), results.end(), false);
+    if (probes.empty())
+      break;
+
+    auto it = probes.find(oracle->wait(passed));
+    Probe probe{std::move(it->second)};
+    probes.erase(it);
+
+    if (passed == probe.schedule.size())
+      continue;
+    uint32_t failed = probe.schedule.position(passed);
+    r.add_edge(failed, probe.i);
+    if (passed == probe.schedule.size() - 1)
+      continue;
+    probe.schedule.exclude(failed);
+
+    if (truncated || (truncated = oracle->exhausted())) {
+      first_unknown = std::min(first_unknown, probe.i);
+      continue;
     }
+    uint64_t ticket = oracle->submit(probe.schedule);
+    probes.emplace(ticket, std::move(probe));
   }
 
-  r->transitive_reduction();
+  // The dependents of the tests from the first one not fully searched on
+  // are unknown: chaining them keeps every test after the ones it may
+  // depend on
+  if (truncated)
+    for (uint32_t j = std::min(i, first_unknown) + 1; j < tests.size(); ++j)
+      r.add_edge(j, j - 1);
 
-  return r;
+  r.transitive_reduction();
+
+  return std::make_unique<Graph>(r.to_graph(tests));
 }
 
-std::unique_ptr<Graph> PraDet::run(const std::vector<uint32_t> &tests,
-                                   TestSuiteOracle *oracle) {
-  std::unique_ptr<Graph> r{std::make_unique<Graph>(tests)};
-  std::set<std::pair<uint32_t, uint32_t>> edges{};
+PFASTDD::Context::Context(const std::vector<uint32_t> &tests,
+                          TestSuiteOracle *oracle)
+    : tests{tests}, oracle{oracle}, closures{(uint32_t)tests.size()},
+      dependents{(uint32_t)tests.size()}, found(closures.words()),
+      needed(closures.words()), positions{}, sched{}, truncated{false} {}
+
+// Each run holds the tests before the i-th one, whose dependencies on the
+// tests before them are unknown, and the candidates left after it with
+// their dependencies. The first failing test is a dependent, and so are
+// its own dependents, while the candidates before it are not.
+void PFASTDD::find_dependents(Context &ctx, uint32_t i) {
+  const std::vector<uint32_t> &tests = ctx.tests;
+  uint32_t n = tests.size();
+
+  std::fill(ctx.found.begin(), ctx.found.end(), 0);
+  for (uint32_t from = i + 1; from < n;) {
+    bool candidates{false};
+
+    std::fill(ctx.needed.begin(), ctx.needed.end(), 0);
+    for (uint32_t t = from; t < n; ++t)
+      if (!(ctx.found[t >> 6] >> (t & 63) & 1)) {
+        ctx.needed[t >> 6] |= (uint64_t)1 << (t & 63);
+        ctx.closures.merge_row(t, ctx.needed);
+        candidates = true;
+      }
+    if (!candidates)
+      break;
+    if ((ctx.truncated = ctx.oracle->exhausted()))
+      return;
+
+    ctx.sched.assign(tests.begin(), tests.begin() + i);
+    ctx.positions.clear();
+    for (uint32_t k = (i + 1) >> 6; k < ctx.needed.size(); ++k)
+      for (uint64_t w = ctx.needed[k]; w; w &= w - 1) {
+        uint32_t t = (k << 6) + std::countr_zero(w);
+        ctx.sched.push_back(tests[t]);
+        ctx.positions.push_back(t);
+      }
+
+    std::vector<bool> results{ctx.oracle->run_tests(ctx.sched)};
+    uint32_t passed =
+        std::find(results.begin(), results.end(), false) - results.begin();
+    // The tests before the i-th one pass like in the suite
+    if (passed == results.size() || passed < i)
+      break;
+
+    uint32_t failed = ctx.positions[passed - i];
+    ctx.found[failed >> 6] |= (uint64_t)1 << (failed & 63);
+    ctx.dependents.merge_row(failed, ctx.found);
+    from = failed + 1;
+  }
+
+  for (uint32_t k = 0; k < ctx.found.size(); ++k)
+    for (uint64_t w = ctx.found[k]; w; w &= w - 1) {
+      uint32_t t = (k << 6) + std::countr_zero(w);
+      ctx.closures.add_edge(t, i);
+      ctx.dependents.add_edge(i, t);
+    }
+}
+
+std::unique_ptr<Graph> PFASTDD::run(const std::vector<uint32_t> &tests,
+                                    TestSuiteOracle *oracle) {
+  Context ctx{tests, oracle};
+  // The tests from i on are searched, the last one has no dependents
+  uint32_t i = tests.size() ? tests.size() - 1 : 0;
+
+  truncated = false;
+  if (checkpointer)
+    if (auto reader = checkpointer->restore("pfast-dd", tests, oracle)) {
+      std::unordered_map<uint32_t, uint32_t> positions;
+
+      i = reader->get();
+      Graph g{reader->get_graph()};
+      check_restored(*reader);
+
+      for (uint32_t j = 0; j < tests.size(); ++j)
+        positions[tests[j]] = j;
+      for (const auto &it : g)
+        for (const uint32_t v : it.second) {
+          ctx.closures.add_edge(positions[it.first], positions[v]);
+          ctx.dependents.add_edge(positions[v], positions[it.first]);
+        }
+    }
+  if (progress)
+    progress->describe("pfast-dd", "test", nullptr);
+
+  for (; i > 0; --i) {
+    if (progress)
+      progress->publish(0, i - 1);
+    if (checkpointer && checkpointer->due()) {
+      CheckpointWriter writer{checkpointer->begin("pfast-dd", tests, oracle)};
+      writer.put(i);
+      writer.put(ctx.closures.to_graph(tests));
+      checkpointer->save(writer);
+    }
+
+    find_dependents(ctx, i - 1);
+    if ((truncated = ctx.truncated))
+      break;
+  }
+
+  // The dependents of the tests before i are unknown: keeping them in
+  // their order, before every later test, keeps the schedules safe
+  if (truncated) {
+    for (uint32_t j = 1; j < i; ++j)
+      ctx.closures.add_edge(j, j - 1);
+    for (uint32_t t = i; t < tests.size(); ++t)
+      ctx.closures.add_edge(t, i - 1);
+  }
+
+  ctx.closures.transitive_reduction();
+
+  return std::make_unique<Graph>(ctx.closures.to_graph(tests));
+}
+
+// The position of t among the sorted nodes.
+static uint32_t position(const std::vector<uint32_t> &nodes, uint32_t t) {
+  return std::lower_bound(nodes.begin(), nodes.end(), t) - nodes.begin();
+}
+
+template <class G, class O>
+std::unique_ptr<Graph>
+BasicPraDet<G, O>::run(const std::vector<uint32_t> &tests,
+                       TestSuiteOracle *suite) {
+  O *oracle{static_cast<O *>(suite)};
+  // The graph is kept over the positions of the sorted tests, so the edges
+  // compare like the ids of their tests
+  std::vector<uint32_t> nodes{tests};
+  std::sort(nodes.begin(), nodes.end());
+  G m{(uint32_t)nodes.size()};
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
   uint32_t tried_edges{0};
 
+  truncated = false;
   if (tests.size() == 0)
-    return r;
+    return std::make_unique<Graph>(tests);
+
+  std::pair<uint32_t, uint32_t> cursor{};
+  std::unique_ptr<CheckpointReader> reader;
+  if (checkpointer)
+    reader = checkpointer->restore("pradet", tests, oracle);
+
+  if (reader) {
+    cursor.first = position(nodes, reader->get());
+    cursor.second = position(nodes, reader->get());
+    std::vector<uint32_t> ids{reader->get_vector()};
+    for (uint32_t i = 0; i + 1 < ids.size(); i += 2)
+      pairs.push_back(
+          std::make_pair(position(nodes, ids[i]), position(nodes, ids[i + 1])));
+    for (const auto &it : reader->get_graph())
+      for (const uint32_t v : it.second)
+        m.add_edge(position(nodes, it.first), position(nodes, v));
+    check_restored(*reader);
+  } else {
+    // Build fully connected graph
+    pairs.reserve((size_t)nodes.size() * (nodes.size() - 1) / 2);
+    for (uint32_t u = 1; u < nodes.size(); ++u)
+      for (uint32_t v = 0; v < u; ++v) {
+        pairs.push_back(std::make_pair(u, v));
+        m.add_edge(u, v);
+      }
+  }
 
-  // Build fully connected graph
-  for (auto it1 = r->begin(); it1 != r->end(); ++it1)
-    for (auto it2 = std::next(it1); it2 != r->end(); ++it2) {
-      edges.insert(std::make_pair(it2->first, it1->first));
-      r->add_edge(it2->first, it1->first);
+  std::vector<uint32_t> ranks(tests.size());
+  for (uint32_t i = 0; i < tests.size(); ++i)
+    ranks[i] = position(nodes, tests[i]);
+
+  EdgeWorklist edges{std::move(pairs)};
+  if (reader)
+    edges.seek(cursor);
+  if (progress)
+    progress->describe("pradet", "remaining_edges", nullptr);
+  typename G::Row deps;
+  std::vector<uint32_t> schedule;
+  while (!edges.empty()) {
+    if (progress)
+      progress->publish(0, edges.size());
+    if (checkpointer && checkpointer->due()) {
+      CheckpointWriter writer{checkpointer->begin("pradet", tests, oracle)};
+      std::vector<uint32_t> ids;
+
+      writer.put(nodes[edges.current().first]);
+      writer.put(nodes[edges.current().second]);
+
+      ids.reserve(2 * edges.size());
+      for (const auto &e : edges.remaining()) {
+        ids.push_back(nodes[e.first]);
+        ids.push_back(nodes[e.second]);
+      }
+      writer.put(ids);
+      writer.put(m.to_graph(nodes));
+      checkpointer->save(writer);
     }
 
-  auto edge{edges.begin()};
-  while (!edges.empty()) {
+    // The edges not tried yet are still in the graph, so stopping here
+    // leaves a graph with all the dependencies that were not disproved
+    if ((truncated = oracle->exhausted()))
+      break;
+
     // Select one edge from the graph
-    r->invert_edge(edge->first, edge->second);
+    std::pair<uint32_t, uint32_t> edge{edges.current()};
+    m.invert_edge(edge.first, edge.second);
     ++tried_edges;
-    std::unordered_set<uint32_t> deps{r->get_dependencies(edge->second)};
-    while (deps.find(edge->second) != deps.end()) {
-      r->invert_edge(edge->second, edge->first);
+    m.dependencies(edge.second, deps);
+    bool cycle{false};
+    while (deps[edge.second >> 6] >> (edge.second & 63) & 1) {
+      m.invert_edge(edge.second, edge.first);
       if (tried_edges == edges.size()) {
-        edge = edges.end();
+        cycle = true;
         break;
       }
-      if (++edge == edges.end())
-        edge = edges.begin();
-      r->invert_edge(edge->first, edge->second);
+      edges.advance();
+      edge = edges.current();
+      m.invert_edge(edge.first, edge.second);
       ++tried_edges;
-      deps = r->get_dependencies(edge->second);
+      m.dependencies(edge.second, deps);
     }
 
-    if (edge == edges.end())
+    if (cycle)
       break;
 
     // Build schedule with the inverted edge
-    std::vector<uint32_t> schedule{};
-    for (const uint32_t t : tests)
-      if (deps.find(t) != deps.end())
-        schedule.push_back(t);
-    schedule.push_back(edge->second);
+    schedule.clear();
+    for (uint32_t i = 0; i < tests.size(); ++i)
+      if (deps[ranks[i] >> 6] >> (ranks[i] & 63) & 1)
+        schedule.push_back(tests[i]);
+    schedule.push_back(nodes[edge.second]);
 
     // Run schedule to get results
     std::vector<bool> results = oracle->run_tests(schedule);
@@ -93,25 +361,307 @@ std::unique_ptr<Graph> PraDet::run(const std::vector<uint32_t> &tests,
 
     // Remove the inverted edge and add the original edge back in case
     // some test fails
-    r->remove_edge(edge->second, edge->first);
+    m.remove_edge(edge.second, edge.first);
     if (first_false != results.end())
-      r->add_edge(edge->first, edge->second);
+      m.add_edge(edge.first, edge.second);
 
-    edge = edges.erase(edge);
+    edges.erase();
     tried_edges = 0;
-    if (edge == edges.end())
-      edge = edges.begin();
   }
 
-  r->transitive_reduction();
+  m.transitive_reduction();
 
-  return r;
+  return std::make_unique<Graph>(m.to_graph(nodes));
 }
 
-MEMFAST::Context::Context(const std::vector<uint32_t> &tests,
-                          TestSuiteOracle *oracle)
-    : failed{}, graph{std::make_unique<Graph>(tests)}, max{0}, oracle{oracle},
-      runned{}, table{tests.size()} {
+PraDetBatch::Context::Context(const std::vector<uint32_t> &tests,
+                              TestSuiteOracle *oracle)
+    : tests{tests}, oracle{oracle}, nodes{tests}, positions(tests.size()),
+      m{(uint32_t)tests.size()}, reversed{(uint32_t)tests.size()},
+      decided{(uint32_t)tests.size()}, progress{0},
+      deps{}, path{}, state(tests.size()),
+      order(tests.size()), stack{}, sched{}, truncated{false} {
+  std::sort(nodes.begin(), nodes.end());
+  for (uint32_t i = 0; i < tests.size(); ++i)
+    positions[i] = position(nodes, tests[i]);
+}
+
+void PraDetBatch::Context::add_edge(uint32_t u, uint32_t v) {
+  m.add_edge(u, v);
+  reversed.add_edge(v, u);
+}
+
+void PraDetBatch::Context::remove_edge(uint32_t u, uint32_t v) {
+  m.remove_edge(u, v);
+  reversed.remove_edge(v, u);
+}
+
+// Whether v is among the dependencies of u. Most paths that close a cycle
+// in the dense graphs of the first rounds have two edges, so those are
+// looked for before the traversal.
+bool PraDetBatch::Context::reaches(uint32_t u, uint32_t v) {
+  return m.meets(u, reversed, v) || m.reaches(u, v, deps, path);
+}
+
+// Runs the tests that the test v of each inverted edge (u, v) of the batch
+// depends on, then v, in topological order. Returns the index of the first
+// failing test, and stores the index of each test into order.
+uint32_t PraDetBatch::Context::run_batch(const edge_list &batch) {
+  std::fill(state.begin(), state.end(), 0);
+  for (const auto &e : batch)
+    state[e.second] = 1;
+
+  // Depth-first search from the roots in the order of the suite, emitting
+  // each test after its dependencies
+  std::vector<uint32_t> roots;
+  for (const uint32_t p : positions)
+    if (state[p])
+      roots.push_back(p);
+
+  std::fill(state.begin(), state.end(), 0);
+  sched.clear();
+  for (const uint32_t root : roots) {
+    if (state[root])
+      continue;
+    state[root] = 1;
+    stack.push_back(std::make_pair(root, 0));
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      uint32_t v = m.next_edge(top.first, top.second);
+
+      while (v < m.size() && state[v])
+        v = m.next_edge(top.first, v + 1);
+      if (v < m.size()) {
+        top.second = v + 1;
+        state[v] = 1;
+        stack.push_back(std::make_pair(v, 0));
+      } else {
+        order[top.first] = sched.size();
+        sched.push_back(nodes[top.first]);
+        stack.pop_back();
+      }
+    }
+  }
+
+  if (truncated || (truncated = oracle->exhausted()))
+    return 0;
+
+  std::vector<bool> results = oracle->run_tests(sched);
+  return std::find(results.begin(), results.end(), false) - results.begin();
+}
+
+// Inverts the edge e unless that closes a cycle, that is unless its test
+// u still reaches v without it.
+bool PraDetBatch::try_invert(Context &ctx,
+                             const std::pair<uint32_t, uint32_t> &e) {
+  ctx.remove_edge(e.first, e.second);
+  if (ctx.reaches(e.first, e.second)) {
+    ctx.add_edge(e.first, e.second);
+    return false;
+  }
+  ctx.add_edge(e.second, e.first);
+  return true;
+}
+
+// Inverts up to limit undecided edges of the worklist, from its cursor on,
+// that share no test with each other and keep the graph acyclic. Once the
+// batch has an edge, the scan stops after as many failed cycle checks as
+// there are tests, so a round does not pay for the whole worklist.
+PraDetBatch::edge_list PraDetBatch::pick_batch(Context &ctx,
+                                               EdgeWorklist &pending,
+                                               uint32_t limit) {
+  std::vector<bool> used(ctx.m.size());
+  edge_list batch;
+  uint32_t failures{0};
+
+  for (uint32_t n = pending.size(); n > 0 && batch.size() < limit; --n) {
+    std::pair<uint32_t, uint32_t> e{pending.current()};
+
+    if (ctx.decided.has_edge(e.first, e.second)) {
+      pending.erase();
+      continue;
+    }
+    pending.advance();
+    if (used[e.first] || used[e.second])
+      continue;
+
+    if (try_invert(ctx, e)) {
+      used[e.first] = used[e.second] = true;
+      batch.push_back(e);
+    } else if (!batch.empty() && ++failures >= ctx.m.size()) {
+      break;
+    }
+  }
+
+  return batch;
+}
+
+// Inverts the edges that share no test with the edges inverted before
+// them and keep the graph acyclic.
+PraDetBatch::edge_list PraDetBatch::invert_batch(Context &ctx,
+                                                 const edge_list &edges) {
+  std::vector<bool> used(ctx.m.size());
+  edge_list batch;
+
+  for (const auto &e : edges) {
+    if (used[e.first] || used[e.second] || !try_invert(ctx, e))
+      continue;
+    used[e.first] = used[e.second] = true;
+    batch.push_back(e);
+  }
+
+  return batch;
+}
+
+// Decides the inverted edges of the batch, restoring or removing them.
+// The edges left undecided, because their inversion closes a cycle once
+// some other edges are restored or because the budget ran out, are
+// restored and stay in the worklist.
+void PraDetBatch::decide(Context &ctx, edge_list &&batch) {
+  uint32_t first_false = ctx.run_batch(batch);
+  edge_list failed;
+
+  for (const auto &e : batch) {
+    ctx.remove_edge(e.second, e.first);
+    // The dependent test passed without the test of the edge before it
+    if (!ctx.truncated && ctx.order[e.first] < first_false) {
+      ctx.decided.add_edge(e.first, e.second);
+      ++ctx.progress;
+      continue;
+    }
+    ctx.add_edge(e.first, e.second);
+    failed.push_back(e);
+  }
+
+  if (ctx.truncated || failed.empty())
+    return;
+
+  // A single edge is decided like in PraDet: the dependency is kept
+  if (batch.size() == 1) {
+    ctx.decided.add_edge(failed[0].first, failed[0].second);
+    ++ctx.progress;
+    return;
+  }
+
+  edge_list halves[2]{edge_list(failed.begin(),
+                                failed.begin() + failed.size() / 2),
+                      edge_list(failed.begin() + failed.size() / 2,
+                                failed.end())};
+  for (const auto &half : halves) {
+    edge_list inverted{invert_batch(ctx, half)};
+    if (!inverted.empty())
+      decide(ctx, std::move(inverted));
+  }
+}
+
+std::unique_ptr<Graph> PraDetBatch::run(const std::vector<uint32_t> &tests,
+                                        TestSuiteOracle *oracle) {
+  Context ctx{tests, oracle};
+  edge_list pairs;
+
+  truncated = false;
+  if (tests.size() == 0)
+    return std::make_unique<Graph>(tests);
+
+  std::pair<uint32_t, uint32_t> cursor{};
+  std::unique_ptr<CheckpointReader> reader;
+  if (checkpointer)
+    reader = checkpointer->restore("pradet-batch", tests, oracle);
+
+  if (reader) {
+    cursor.first = position(ctx.nodes, reader->get());
+    cursor.second = position(ctx.nodes, reader->get());
+    std::vector<uint32_t> ids{reader->get_vector()};
+    for (uint32_t i = 0; i + 1 < ids.size(); i += 2)
+      pairs.push_back(std::make_pair(position(ctx.nodes, ids[i]),
+                                     position(ctx.nodes, ids[i + 1])));
+    for (const auto &it : reader->get_graph())
+      for (const uint32_t v : it.second)
+        ctx.add_edge(position(ctx.nodes, it.first), position(ctx.nodes, v));
+    check_restored(*reader);
+  } else {
+    // Build fully connected graph
+    pairs.reserve((size_t)ctx.nodes.size() * (ctx.nodes.size() - 1) / 2);
+    for (uint32_t u = 1; u < ctx.nodes.size(); ++u)
+      for (uint32_t v = 0; v < u; ++v) {
+        pairs.push_back(std::make_pair(u, v));
+        ctx.add_edge(u, v);
+      }
+  }
+
+  EdgeWorklist pending{std::move(pairs)};
+  if (reader)
+    pending.seek(cursor);
+  if (progress)
+    progress->describe("pradet-batch", "remaining_edges", nullptr);
+  uint32_t limit = tests.size();
+  while (!pending.empty()) {
+    if (progress)
+      progress->publish(0, pending.size());
+    if (checkpointer && checkpointer->due()) {
+      CheckpointWriter writer{
+          checkpointer->begin("pradet-batch", tests, oracle)};
+      std::vector<uint32_t> ids;
+
+      writer.put(ctx.nodes[pending.current().first]);
+      writer.put(ctx.nodes[pending.current().second]);
+
+      ids.reserve(2 * pending.size());
+      for (const auto &e : pending.remaining()) {
+        if (ctx.decided.has_edge(e.first, e.second))
+          continue;
+        ids.push_back(ctx.nodes[e.first]);
+        ids.push_back(ctx.nodes[e.second]);
+      }
+      writer.put(ids);
+      writer.put(ctx.m.to_graph(ctx.nodes));
+      checkpointer->save(writer);
+    }
+
+    // The edges not tried yet are still in the graph, so stopping here
+    // leaves a graph with all the dependencies that were not disproved
+    if ((truncated = oracle->exhausted()))
+      break;
+
+    // An empty batch means that the worklist only held decided edges, or
+    // that every remaining inversion closes a cycle
+    edge_list batch{pick_batch(ctx, pending, limit)};
+    if (batch.empty())
+      break;
+
+    uint32_t before = ctx.progress;
+    decide(ctx, std::move(batch));
+    if ((truncated = ctx.truncated))
+      break;
+
+    // When restoring some edges closed cycles with the others and nothing
+    // got decided, the next batch is a single edge
+    limit = ctx.progress == before ? 1 : tests.size();
+  }
+
+  ctx.m.transitive_reduction();
+
+  return std::make_unique<Graph>(ctx.m.to_graph(ctx.nodes));
+}
+
+template <class G, class O>
+BasicMEMFAST<G, O>::Position::Position(Stage stage, uint32_t rank,
+                                       uint32_t prefix_len)
+    : stage{stage}, rank{rank}, prefix_len{prefix_len}, base{0}, idx{0},
+      s1{}, s2{}, passing{}, new_passing{} {}
+
+template <class G, class O>
+BasicMEMFAST<G, O>::Context::Context(const std::vector<uint32_t> &tests,
+                                     O *oracle)
+    : tests{tests}, failed{}, positions{}, graph{(uint32_t)tests.size()},
+      max{0}, oracle{oracle}, runned{}, table{tests.size()}, resume{},
+      truncated{false} {
+  for (uint32_t i = 0; i < tests.size(); ++i)
+    positions[tests[i]] = i;
+}
+
+template <class G, class O>
+void BasicMEMFAST<G, O>::Context::run_single_tests(void) {
   for (const uint32_t t : tests) {
     schedule schedule{t};
 
@@ -120,105 +670,215 @@ MEMFAST::Context::Context(const std::vector<uint32_t> &tests,
   }
 }
 
-std::vector<bool> MEMFAST::Context::run_schedule(const schedule &schedule) {
-  auto it = runned.insert(schedule);
+// Once the budget is exhausted, every schedule is reported as failing
+// without running it, and the search loops unwind at their next iteration
+template <class G, class O>
+std::vector<bool>
+BasicMEMFAST<G, O>::Context::run_schedule(const schedule &schedule) {
+  if (truncated || (truncated = oracle->exhausted()))
+    return std::vector<bool>(schedule.size(), false);
+
+  bool fresh = runned.insert(schedule).second;
 
   std::vector<bool> result = oracle->run_tests(schedule);
+  record_schedule(schedule, result, fresh);
+
+  return result;
+}
+
+// Starts running the schedule, unless the budget is exhausted. fresh tells
+// whether the schedule never ran before.
+template <class G, class O>
+bool BasicMEMFAST<G, O>::Context::submit_schedule(const schedule &schedule,
+                                                  uint64_t &ticket,
+                                                  bool &fresh) {
+  if (truncated || (truncated = oracle->exhausted()))
+    return false;
+
+  fresh = runned.insert(schedule).second;
+  ticket = oracle->submit(schedule);
 
-  if (it.second && result[schedule.size() - 1]) {
+  return true;
+}
+
+template <class G, class O>
+void BasicMEMFAST<G, O>::Context::record_schedule(
+    const schedule &schedule, const std::vector<bool> &result, bool fresh) {
+  if (fresh && result[schedule.size() - 1]) {
     table[schedule.size() - 1].insert(schedule);
     if (schedule.size() - 1 > max)
       max = schedule.size() - 1;
   }
-
-  return result;
 }
 
-bool MEMFAST::Context::runned_schedule(const schedule &schedule) {
+template <class G, class O>
+bool BasicMEMFAST<G, O>::Context::runned_schedule(const schedule &schedule) {
   return runned.find(schedule) != runned.end();
 }
 
-void MEMFAST::append_failed_tests(Context &ctx, uint32_t rank) {
-  for (const schedule &seq : ctx.table[rank - 1]) {
-    schedule schedule(seq);
+template <class G, class O>
+void BasicMEMFAST<G, O>::Context::add_edge(uint32_t u, uint32_t v) {
+  graph.add_edge(positions[u], positions[v]);
+}
 
-    for (auto test = ctx.failed.begin(); test != ctx.failed.end();) {
-      if (schedule.back() > *test) {
+template <class G, class O>
+void BasicMEMFAST<G, O>::append_failed_tests(Context &ctx, uint32_t rank) {
+  std::unique_ptr<Position> resume{std::move(ctx.resume)};
+  std::map<uint64_t, Probe> probes;
+  std::vector<bool> results;
+  auto seq = resume ? ctx.table[rank - 1].find(resume->s1)
+                    : ctx.table[rank - 1].begin();
+
+  for (; seq != ctx.table[rank - 1].end() && !ctx.truncated; ++seq) {
+    if (checkpointer && checkpointer->due()) {
+      Position pos{Stage::append, rank, 0};
+      pos.s1 = *seq;
+      save_checkpoint(ctx, pos);
+    }
+
+    schedule schedule(*seq);
+
+    // The failed tests appended to the same schedule are run independently,
+    // so up to window() of them are in flight at once. A test that passes
+    // is only dropped from the failed tests for the next schedules.
+    auto test = ctx.failed.begin();
+    while (test != ctx.failed.end() || !probes.empty()) {
+      if (test != ctx.failed.end() && probes.size() < ctx.oracle->window()) {
+        uint64_t ticket;
+        bool fresh;
+
+        if (schedule.back() <= *test) {
+          schedule.push_back(*test);
+          if (ctx.submit_schedule(schedule, ticket, fresh))
+            probes.emplace(ticket, Probe{*test, fresh});
+          schedule.pop_back();
+        }
         ++test;
         continue;
       }
 
-      schedule.push_back(*test);
-      std::vector<bool> results = ctx.run_schedule(schedule);
+      auto it = probes.find(ctx.oracle->wait(results));
+      Probe probe{it->second};
+      probes.erase(it);
+
+      schedule.push_back(probe.test);
+      ctx.record_schedule(schedule, results, probe.fresh);
       schedule.pop_back();
 
       if (results.back()) {
-        ctx.graph->add_edge(*test, schedule.back());
-        test = ctx.failed.erase(test);
-      } else {
-        ++test;
+        ctx.add_edge(probe.test, schedule.back());
+        ctx.failed.erase(probe.test);
       }
     }
   }
 }
 
-void MEMFAST::extensive_search(Context &ctx, uint32_t rank,
-                               uint32_t prefix_len) {
-  std::set<schedule> passing;
-
-  for (uint32_t base = 1; base <= prefix_len / 2; ++base) {
+template <class G, class O>
+void BasicMEMFAST<G, O>::extensive_search(Context &ctx, uint32_t rank,
+                                          uint32_t prefix_len) {
+  std::unique_ptr<Position> resume{std::move(ctx.resume)};
+  schedule_set passing;
+  schedule sched;
+
+  if (!resume || resume->stage == Stage::candidates) {
+    if (resume)
+      passing = std::move(resume->passing);
+
+    for (uint32_t base = resume ? resume->base : 1; base <= prefix_len / 2;
+         ++base) {
+      auto s1 = resume ? ctx.table[base - 1].find(resume->s1)
+                       : ctx.table[base - 1].begin();
+
+      for (; s1 != ctx.table[base - 1].end(); ++s1) {
+
+        // The schedules of table[idx] have idx + 1 tests, so the later
+        // rows cannot merge into a schedule of prefix_len tests
+        for (uint32_t idx = resume ? resume->idx : prefix_len - base - 1;
+             idx <= ctx.max && idx < prefix_len; ++idx) {
+          auto s2 = resume ? ctx.table[idx].find(resume->s2)
+                           : ctx.table[idx].begin();
+          resume.reset();
+
+          for (; s2 != ctx.table[idx].end(); ++s2) {
+            if (ctx.truncated)
+              return;
+            if (checkpointer && checkpointer->due()) {
+              Position pos{Stage::candidates, rank, prefix_len};
+              pos.base = base;
+              pos.s1 = *s1;
+              pos.idx = idx;
+              pos.s2 = *s2;
+              pos.passing = passing;
+              save_checkpoint(ctx, pos);
+            }
 
-    for (const schedule &s1 : ctx.table[base - 1]) {
+            if (!sorted_union_fits(*s1, *s2, prefix_len))
+              continue;
+            sorted_union(*s1, *s2, sched);
 
-      for (uint32_t idx = prefix_len - base - 1; idx <= ctx.max; ++idx) {
+            ctx.run_schedule(sched);
 
-        for (const schedule &s2 : ctx.table[idx]) {
-          schedule sched = merge_schedules(s1, s2);
-          if (sched.empty() || sched.size() > prefix_len)
-            continue;
+            for (auto test = ctx.failed.begin(); test != ctx.failed.end();) {
+              if (sched.back() > *test) {
+                ++test;
+                continue;
+              }
 
-          ctx.run_schedule(sched);
+              sched.push_back(*test);
 
-          for (auto test = ctx.failed.begin(); test != ctx.failed.end();) {
-            if (sched.back() > *test) {
-              ++test;
-              continue;
-            }
+              if (ctx.runned_schedule(sched)) {
+                sched.pop_back();
+                ++test;
+                continue;
+              }
 
-            sched.push_back(*test);
+              std::vector<bool> results = ctx.run_schedule(sched);
 
-            if (ctx.runned_schedule(sched)) {
-              sched.pop_back();
-              ++test;
-              continue;
-            }
+              if (results.back()) {
+                for (uint32_t i = 0; i < sched.size() - 1; ++i)
+                  ctx.add_edge(*test, sched[i]);
 
-            std::vector<bool> results = ctx.run_schedule(sched);
+                if (sched.size() <= rank)
+                  passing.insert(sched);
 
-            if (results.back()) {
-              for (uint32_t i = 0; i < sched.size() - 1; ++i)
-                ctx.graph->add_edge(*test, sched[i]);
+                test = ctx.failed.erase(test);
+              } else {
+                ++test;
+              }
 
-              if (sched.size() <= rank)
-                passing.insert(sched);
-
-              test = ctx.failed.erase(test);
-            } else {
-              ++test;
+              sched.pop_back();
             }
-
-            sched.pop_back();
           }
         }
       }
     }
   }
 
+  if (resume)
+    passing = std::move(resume->passing);
+
   while (!passing.empty()) {
-    std::set<schedule> new_passing;
+    schedule_set new_passing;
+    auto item = passing.begin();
 
-    for (const auto &item : passing) {
-      schedule sched{item};
+    if (resume) {
+      new_passing = std::move(resume->new_passing);
+      item = passing.find(resume->s1);
+      resume.reset();
+    }
+
+    for (; item != passing.end(); ++item) {
+      if (ctx.truncated)
+        return;
+      if (checkpointer && checkpointer->due()) {
+        Position pos{Stage::passing, rank, prefix_len};
+        pos.s1.assign(item->begin(), item->end());
+        pos.passing = passing;
+        pos.new_passing = new_passing;
+        save_checkpoint(ctx, pos);
+      }
+
+      schedule sched{*item};
 
       for (auto test = ctx.failed.begin(); test != ctx.failed.end();) {
         if (sched.back() > *test) {
@@ -230,7 +890,7 @@ void MEMFAST::extensive_search(Context &ctx, uint32_t rank,
         std::vector<bool> results = ctx.run_schedule(sched);
 
         if (results.back()) {
-          ctx.graph->add_edge(*test, sched[sched.size() - 2]);
+          ctx.add_edge(*test, sched[sched.size() - 2]);
 
           if (sched.size() <= rank)
             new_passing.insert(sched);
@@ -244,73 +904,658 @@ void MEMFAST::extensive_search(Context &ctx, uint32_t rank,
       }
     }
 
-    passing.swap(new_passing);
+    passing = std::move(new_passing);
   }
 }
 
-schedule MEMFAST::merge_schedules(const schedule &s1, const schedule &s2) {
-  schedule result;
-  result.reserve(s1.size() + s2.size() + 1);
-  uint32_t i = 0, j = 0;
+template <class G, class O>
+void BasicMEMFAST<G, O>::save_checkpoint(Context &ctx, const Position &pos) {
+  // Past the budget the loops skip work they would otherwise have done
+  if (ctx.truncated)
+    return;
+
+  CheckpointWriter writer{checkpointer->begin("mem-fast", ctx.tests,
+                                              ctx.oracle)};
+
+  writer.put((uint64_t)pos.stage);
+  writer.put(pos.rank);
+  writer.put(pos.prefix_len);
+  writer.put(pos.base);
+  writer.put(pos.idx);
+  writer.put(pos.s1);
+  writer.put(pos.s2);
+  writer.put(pos.passing);
+  writer.put(pos.new_passing);
+
+  writer.put(ctx.failed);
+  writer.put(ctx.graph.to_graph(ctx.tests));
+  writer.put(ctx.max);
+  writer.put(ctx.runned);
+  for (const auto &schedules : ctx.table)
+    writer.put(schedules);
+
+  checkpointer->save(writer);
+}
 
-  while (i < s1.size() && j < s2.size()) {
-    if (s1[i] < s2[j]) {
-      result.push_back(s1[i++]);
-    } else if (s1[i] > s2[j]) {
-      result.push_back(s2[j++]);
-    } else {
-      result.push_back(s1[i++]);
-      ++j;
+template <class G, class O>
+void BasicMEMFAST<G, O>::restore_checkpoint(Context &ctx,
+                                            CheckpointReader &reader) {
+  Stage stage = (Stage)reader.get();
+  uint32_t rank = reader.get();
+  uint32_t prefix_len = reader.get();
+
+  ctx.resume.reset(new Position{stage, rank, prefix_len});
+  ctx.resume->base = reader.get();
+  ctx.resume->idx = reader.get();
+  ctx.resume->s1 = reader.get_vector();
+  ctx.resume->s2 = reader.get_vector();
+  ctx.resume->passing = reader.get_schedules();
+  ctx.resume->new_passing = reader.get_schedules();
+
+  ctx.failed = reader.get_set();
+  add_edges(ctx.graph, reader.get_graph(), ctx.tests);
+  ctx.max = reader.get();
+  ctx.runned = reader.get_schedules();
+  for (auto &schedules : ctx.table)
+    schedules = reader.get_schedules();
+
+  check_restored(reader);
+}
+
+template <class G, class O>
+std::unique_ptr<Graph>
+BasicMEMFAST<G, O>::run(const std::vector<uint32_t> &tests,
+                        TestSuiteOracle *oracle) {
+  Context ctx{tests, static_cast<O *>(oracle)};
+  uint32_t rank{1}, prefix_len{0};
+  std::unique_ptr<CheckpointReader> reader;
+
+  truncated = false;
+  if (progress)
+    progress->describe("mem-fast", "rank", "prefix_len");
+  if (checkpointer)
+    reader = checkpointer->restore("mem-fast", tests, oracle);
+
+  if (reader) {
+    restore_checkpoint(ctx, *reader);
+    rank = ctx.resume->rank;
+    if (ctx.resume->stage != Stage::append)
+      prefix_len = ctx.resume->prefix_len;
+  } else {
+    ctx.run_single_tests();
+  }
+
+  if (tests.size() == 0)
+    return std::make_unique<Graph>(tests);
+
+  // A zero prefix_len means the failed tests were not appended yet to the
+  // passing schedules of the current rank
+  for (; rank < tests.size() && !ctx.truncated; ++rank, prefix_len = 0) {
+    if (progress)
+      progress->publish(0, rank);
+    if (prefix_len == 0) {
+      append_failed_tests(ctx, rank);
+
+      if (ctx.failed.empty())
+        break;
+      else if (ctx.failed.find(tests[rank]) == ctx.failed.end())
+        continue;
+
+      prefix_len = 2;
+    }
+
+    while (!ctx.truncated) {
+      if (progress)
+        progress->publish(1, prefix_len);
+      extensive_search(ctx, rank, prefix_len);
+
+      if (ctx.failed.find(tests[rank]) == ctx.failed.end())
+        break;
+      ++prefix_len;
     }
   }
 
-  for (; i < s1.size(); ++i)
-    result.push_back(s1[i]);
-  for (; j < s2.size(); ++j)
-    result.push_back(s2[j]);
+  // The tests that still fail may depend on any test before them
+  truncated = ctx.truncated;
+  if (truncated)
+    for (uint32_t i = 0; i < tests.size(); ++i)
+      if (ctx.failed.find(tests[i]) != ctx.failed.end())
+        for (uint32_t j = 0; j < i; ++j)
+          ctx.graph.add_edge(i, j);
 
-  return result;
+  ctx.graph.transitive_reduction();
+
+  return std::make_unique<Graph>(ctx.graph.to_graph(tests));
 }
 
-std::unique_ptr<Graph> MEMFAST::run(const std::vector<uint32_t> &tests,
-                                    TestSuiteOracle *oracle) {
+Bisect::Context::Context(const std::vector<uint32_t> &tests,
+                         TestSuiteOracle *oracle)
+    : tests{tests}, oracle{oracle}, closures(tests.size()), found{},
+      marked(tests.size()), sched{}, truncated{false} {}
+
+// Whether the i-th test passes when run after the first prefix tests and
+// the dependencies found so far, each preceded by its own dependencies.
+// Once the budget is exhausted, the test is reported as failing without
+// running it.
+bool Bisect::Context::run_after(uint32_t i, uint32_t prefix) {
+  if (truncated || (truncated = oracle->exhausted()))
+    return false;
+
+  std::fill(marked.begin(), marked.begin() + i, false);
+  std::fill(marked.begin(), marked.begin() + prefix, true);
+  for (const uint32_t x : found) {
+    marked[x] = true;
+    for (const uint32_t y : closures[x])
+      marked[y] = true;
+  }
+
+  sched.clear();
+  for (uint32_t j = 0; j < i; ++j)
+    if (marked[j])
+      sched.push_back(tests[j]);
+  sched.push_back(tests[i]);
+
+  return oracle->run_tests(sched).back();
+}
+
+void Bisect::Context::store_closure(uint32_t i) {
+  std::fill(marked.begin(), marked.begin() + i, false);
+  for (const uint32_t x : found) {
+    marked[x] = true;
+    for (const uint32_t y : closures[x])
+      marked[y] = true;
+  }
+
+  for (uint32_t j = 0; j < i; ++j)
+    if (marked[j])
+      closures[i].push_back(j);
+}
+
+void Bisect::find_dependencies(Context &ctx, uint32_t i) {
+  // Running after the first hi tests passes
+  uint32_t hi{i};
+
+  ctx.found.clear();
+  while (hi > 0 && !ctx.run_after(i, 0)) {
+    // Running after the first lo tests fails
+    uint32_t lo{0};
+
+    while (hi - lo > 1 && !ctx.truncated) {
+      uint32_t mid = lo + (hi - lo) / 2;
+
+      if (ctx.run_after(i, mid))
+        hi = mid;
+      else
+        lo = mid;
+    }
+
+    if (ctx.truncated)
+      return;
+
+    // Everything before the test at hi - 1 was not enough without it,
+    // so the test depends on it
+    ctx.found.push_back(--hi);
+  }
+}
+
+std::unique_ptr<Graph> Bisect::run(const std::vector<uint32_t> &tests,
+                                   TestSuiteOracle *oracle) {
+  std::unique_ptr<Graph> r{std::make_unique<Graph>(tests)};
   Context ctx{tests, oracle};
+  uint32_t i{0};
 
-  if (tests.size() == 0)
-    return std::move(ctx.graph);
+  truncated = false;
+
+  if (checkpointer)
+    if (auto reader = checkpointer->restore("bisect", tests, oracle)) {
+      std::unordered_map<uint32_t, uint32_t> positions;
+
+      i = reader->get();
+      *r = reader->get_graph();
+      check_restored(*reader);
+
+      for (uint32_t j = 0; j < tests.size(); ++j)
+        positions[tests[j]] = j;
+      for (uint32_t j = 0; j < i && j < tests.size(); ++j) {
+        for (const uint32_t dep : r->get_dependencies(tests[j]))
+          ctx.closures[j].push_back(positions[dep]);
+        std::sort(ctx.closures[j].begin(), ctx.closures[j].end());
+      }
+    }
 
-  for (uint32_t rank = 1; rank < tests.size(); ++rank) {
-    append_failed_tests(ctx, rank);
+  if (progress)
+    progress->describe("bisect", "test", nullptr);
+  for (; i < tests.size(); ++i) {
+    if (progress)
+      progress->publish(0, i);
+    if (checkpointer && checkpointer->due()) {
+      CheckpointWriter writer{checkpointer->begin("bisect", tests, oracle)};
+      writer.put(i);
+      writer.put(*r);
+      checkpointer->save(writer);
+    }
 
-    if (ctx.failed.empty())
+    find_dependencies(ctx, i);
+    if ((truncated = ctx.truncated))
       break;
-    else if (ctx.failed.find(tests[rank]) == ctx.failed.end())
+
+    for (const uint32_t x : ctx.found)
+      r->add_edge(tests[i], tests[x]);
+    ctx.store_closure(i);
+  }
+
+  if (truncated)
+    chain_from(*r, tests, i);
+
+  r->transitive_reduction();
+
+  return r;
+}
+
+void Bisect::chain_from(Graph &r, const std::vector<uint32_t> &tests,
+                        uint32_t i) {
+  // The tests from i on may depend on any test before them
+  for (uint32_t j = 0; j < i; ++j)
+    r.add_edge(tests[i], tests[j]);
+  for (uint32_t j = i + 1; j < tests.size(); ++j)
+    r.add_edge(tests[j], tests[j - 1]);
+}
+
+Incremental::Incremental(const Graph &previous,
+                         std::unique_ptr<Algorithm> &&full)
+    : previous{previous}, full{std::move(full)}, searched_all{false} {}
+
+// Takes the closures of the previous graph for the tests still in the
+// suite, leaving out the tests that are gone. The new tests and the ones
+// that now run before a test they depended on are searched again.
+void Incremental::reuse_closures(Context &ctx, std::vector<bool> &redo) {
+  const std::vector<uint32_t> &tests = ctx.tests;
+  std::unordered_map<uint32_t, uint32_t> positions;
+
+  for (uint32_t j = 0; j < tests.size(); ++j)
+    positions[tests[j]] = j;
+
+  for (uint32_t j = 0; j < tests.size(); ++j) {
+    redo[j] = !previous.has_node(tests[j]);
+    if (redo[j])
       continue;
 
-    uint32_t prefix_len = 2;
-    while (true) {
-      extensive_search(ctx, rank, prefix_len);
+    for (const uint32_t dep : previous.get_dependencies(tests[j])) {
+      auto it = positions.find(dep);
+      if (it == positions.end())
+        continue;
+      if (it->second >= j) {
+        redo[j] = true;
+        break;
+      }
+      ctx.closures[j].push_back(it->second);
+    }
 
-      if (ctx.failed.find(tests[rank]) == ctx.failed.end())
+    if (redo[j])
+      ctx.closures[j].clear();
+    else
+      std::sort(ctx.closures[j].begin(), ctx.closures[j].end());
+  }
+}
+
+// Runs each reused test after just its closure, starting from the last
+// tests, whose schedules confirm at once the tests of the closure that run
+// after just their own. A test that fails is searched again, and the tests
+// depending on it are left unconfirmed: their schedules would fail on it
+// too.
+void Incremental::confirm(Context &ctx, std::vector<bool> &redo,
+                          std::vector<bool> &confirmed) {
+  const std::vector<uint32_t> &tests = ctx.tests;
+
+  for (uint32_t j = tests.size(); j-- > 0;) {
+    bool blocked{redo[j] || confirmed[j]};
+    for (uint32_t k = 0; k < ctx.closures[j].size() && !blocked; ++k)
+      blocked = redo[ctx.closures[j][k]];
+    if (blocked)
+      continue;
+    if ((ctx.truncated = ctx.oracle->exhausted()))
+      return;
+
+    ctx.sched.clear();
+    for (const uint32_t x : ctx.closures[j])
+      ctx.sched.push_back(tests[x]);
+    ctx.sched.push_back(tests[j]);
+
+    std::vector<bool> results = ctx.oracle->run_tests(ctx.sched);
+    for (uint32_t k = 0; k < results.size(); ++k) {
+      uint32_t x = k < ctx.closures[j].size() ? ctx.closures[j][k] : j;
+      if (!results[k]) {
+        redo[x] = true;
         break;
-      ++prefix_len;
+      }
+      // Passing after more than its closure proves nothing about it
+      if (ctx.closures[x].size() == k)
+        confirmed[x] = true;
     }
   }
+}
+
+// A test still passes after a dependency it lost, so the confirmation runs
+// keep every stale dependency of the previous graph. Like in the probes of
+// PFAST, each direct dependency of the i-th test, from the last one, is
+// left out of its run, keeping its own direct dependencies: the test does
+// not depend on it when it still passes, and those take its place.
+void Incremental::drop_stale(Context &ctx, uint32_t i,
+                             const std::vector<std::vector<uint32_t>> &direct) {
+  std::set<uint32_t> kept;
+
+  std::fill(ctx.marked.begin(), ctx.marked.begin() + i, false);
+  for (const uint32_t x : ctx.found)
+    for (const uint32_t y : ctx.closures[x])
+      ctx.marked[y] = true;
+  for (const uint32_t x : ctx.found)
+    if (!ctx.marked[x])
+      kept.insert(x);
+
+  for (uint32_t bound = i; !ctx.truncated;) {
+    auto it = kept.lower_bound(bound);
+    if (it == kept.begin())
+      break;
+    bound = *--it;
+
+    std::set<uint32_t> without{kept};
+    without.erase(bound);
+    without.insert(direct[bound].begin(), direct[bound].end());
+    ctx.found.assign(without.begin(), without.end());
+    if (ctx.run_after(i, 0))
+      kept = std::move(without);
+  }
+
+  ctx.found.assign(kept.begin(), kept.end());
+}
+
+std::unique_ptr<Graph>
+Incremental::search_all(const std::vector<uint32_t> &tests,
+                        TestSuiteOracle *oracle) {
+  searched_all = true;
+  full->set_checkpointer(checkpointer);
+  full->set_progress(progress);
+  std::unique_ptr<Graph> g{full->run(tests, oracle)};
+  truncated = full->is_truncated();
+
+  return g;
+}
 
-  ctx.graph->transitive_reduction();
+// The runs Bisect takes to search again the tests to redo from the given
+// one on, with about deps dependencies each
+static double search_runs(const std::vector<bool> &redo, uint32_t from,
+                          double deps) {
+  double runs{0};
 
-  return std::move(ctx.graph);
+  for (uint32_t j = from; j < redo.size(); ++j)
+    if (redo[j])
+      runs += deps * std::log2(j + 1) + 1;
+
+  return runs;
 }
 
-std::unique_ptr<Algorithm> algorithm_factory(const std::string &algo) {
+std::unique_ptr<Graph> Incremental::run(const std::vector<uint32_t> &tests,
+                                        TestSuiteOracle *oracle) {
+  std::unique_ptr<Graph> r{std::make_unique<Graph>(tests)};
+  Context ctx{tests, oracle};
+  std::vector<bool> redo(tests.size()), confirmed(tests.size());
+  // The dependencies found for each test, not reached through another one
+  std::vector<std::vector<uint32_t>> direct(tests.size());
+  double n = tests.size(), deps{0}, closures{0}, reused{0};
+  uint32_t i{0};
+
+  truncated = false;
+  searched_all = false;
+  reuse_closures(ctx, redo);
+
+  // The update takes a confirmation run and a run per direct dependency
+  // for each reused test, and a search for each test to redo, while a
+  // full search takes about a run per test and one per pair of dependent
+  // tests, like PFAST in Auto. Both are estimated from the previous graph.
+  for (const auto &it : previous)
+    deps += it.second.size();
+  deps = previous.size() ? deps / previous.size() : 0;
+  for (uint32_t j = 0; j < tests.size(); ++j)
+    if (!redo[j]) {
+      closures += ctx.closures[j].size();
+      ++reused;
+    }
+  if (reused * (deps + 1) + search_runs(redo, 0, deps) >
+      n - 1 + (reused ? closures / reused : 0) * n)
+    return search_all(tests, oracle);
+
+  confirm(ctx, redo, confirmed);
+  if ((uint32_t)std::count(redo.begin(), redo.end(), true) > n / 2)
+    return search_all(tests, oracle);
+
+  // The stale dependencies reached through a dropped one cost a run each
+  // too, so from the first eighth of the suite on, the runs of the reused
+  // tests and the dependencies of a full search are projected from the
+  // tests done so far instead
+  double searches{search_runs(redo, 0, deps)}, reused_runs{0};
+  uint32_t reused_done{0}, reused_left =
+                               std::count(redo.begin(), redo.end(), false);
+  closures = 0;
+
+  if (progress)
+    progress->describe("incremental", "test", nullptr);
+  for (; i < tests.size(); ++i) {
+    if (progress)
+      progress->publish(0, i);
+    if (i >= std::max<uint32_t>(n / 8, 1) && reused_done > 0 &&
+        searches + reused_left * reused_runs / reused_done >
+            n - 1 + closures / i * n)
+      return search_all(tests, oracle);
+
+    uint64_t before = oracle->get_test_suite_runs();
+    ctx.found = std::move(ctx.closures[i]);
+    ctx.closures[i].clear();
+
+    // An unconfirmed test may still pass after its previous dependencies,
+    // now with the ones found again for them
+    if (redo[i] || (!confirmed[i] && !ctx.run_after(i, 0)))
+      find_dependencies(ctx, i);
+    else
+      drop_stale(ctx, i, direct);
+    if ((truncated = ctx.truncated))
+      break;
+
+    for (const uint32_t x : ctx.found)
+      r->add_edge(tests[i], tests[x]);
+    ctx.store_closure(i);
+    closures += ctx.closures[i].size();
+    direct[i] = ctx.found;
+
+    if (redo[i]) {
+      searches -= deps * std::log2(i + 1) + 1;
+    } else {
+      reused_runs += oracle->get_test_suite_runs() - before;
+      ++reused_done;
+      --reused_left;
+    }
+  }
+
+  if (truncated)
+    chain_from(*r, tests, i);
+
+  r->transitive_reduction();
+
+  return r;
+}
+
+void Incremental::add_metrics(MetricsRow &row) const {
+  if (searched_all)
+    full->add_metrics(row);
+}
+
+// The algorithms Auto picks from, numbered like in its metrics. PFAST-DD
+// comes first since it never takes more runs than PFAST.
+static const char *const auto_candidates[] = {"pfast-dd", "pfast", "pradet",
+                                              "mem-fast"};
+// The most probes Auto runs, one per eight tests up to there
+static const uint32_t auto_max_probes = 32;
+// The runs PFAST-DD takes per test with dependents, fitted on local runs
+// of generated suites
+static const double pfast_dd_runs_per_hub = 2.5;
+
+Auto::Auto(void)
+    : choice{0}, probe_suite_runs{0}, probe_test_runs{0}, predicted_runs{0} {}
+
+// The probes leave out tests spread evenly over the suite. The first test
+// failing without the j-th one depends on it, and the tests passing between
+// them do not. The dependents of a test cluster after its first one, since
+// the tests depending on that one depend on it too, so the tests from the
+// first failure on are counted as its dependents. That overestimates sparse
+// graphs, where PFAST-DD is the cheapest anyway.
+Auto::Estimate Auto::probe(const std::vector<uint32_t> &tests,
+                           TestSuiteOracle *oracle) {
+  uint32_t n = tests.size();
+  uint32_t probes = std::min(auto_max_probes, (n + 7) / 8);
+  std::map<uint64_t, uint32_t> pending;
+  uint64_t later{0}, dependents{0}, failures{0};
+  uint32_t passed, k{0}, done{0};
+
+  while (k < probes || !pending.empty()) {
+    if (k < probes && pending.size() < oracle->window() &&
+        !oracle->exhausted()) {
+      ScheduleView schedule{tests};
+      uint32_t j = (uint64_t)k * (n - 1) / probes;
+
+      schedule.exclude(j);
+      pending[oracle->submit(schedule)] = j;
+      ++k;
+      continue;
+    }
+    if (pending.empty())
+      break;
+
+    auto it = pending.find(oracle->wait(passed));
+    uint32_t j = it->second;
+    pending.erase(it);
+    ++done;
+    if (progress)
+      progress->publish(0, done);
+
+    if (passed < j)
+      continue;
+    later += n - 1 - j;
+    if (passed < n - 1) {
+      dependents += n - 1 - passed;
+      ++failures;
+    }
+  }
+
+  return Estimate{later ? (double)dependents / later : 0,
+                  done ? (double)failures / done : 0};
+}
+
+std::unique_ptr<Graph> Auto::run(const std::vector<uint32_t> &tests,
+                                 TestSuiteOracle *oracle) {
+  uint64_t suite_runs = oracle->get_test_suite_runs();
+  uint64_t runs = oracle->get_test_runs();
+  double n = tests.size();
+
+  if (progress)
+    progress->describe("auto", "probe", nullptr);
+  Estimate estimate{probe(tests, oracle)};
+  probe_suite_runs = oracle->get_test_suite_runs() - suite_runs;
+  probe_test_runs = oracle->get_test_runs() - runs;
+
+  // PFAST-DD runs the suite once per test and a few times per test with
+  // dependents, but no more than once per dependent or per pair of tests
+  // that do not depend on each other. PFAST runs it once per test and once
+  // per dependent, PraDet once per test, once per pair of tests that do not
+  // depend on each other and about once per test with dependents to keep
+  // its direct ones. MEM-FAST runs each test alone, then searches the
+  // failing ones among schedules growing with the suite.
+  double pairs = n * (n - 1) / 2;
+  double closure = estimate.share * pairs;
+  double hubs = estimate.hubs * n;
+  double window = std::max<uint32_t>(oracle->window(), 1);
+  double predicted[] = {
+      n - 1 +
+          std::min({closure, pairs - closure, pfast_dd_runs_per_hub * hubs}),
+      n - 1 + closure, n - 1 + pairs - closure + hubs, n + hubs * n};
+  // Only the appends of MEM-FAST run in flight together, and the model
+  // does not tell them from its searches, so its runs all count
+  double waits[] = {predicted[0], predicted[1] / window, predicted[2],
+                    predicted[3]};
+
+  choice = 0;
+  for (uint32_t i = 1; i < std::size(waits); ++i)
+    if (waits[i] < waits[choice])
+      choice = i;
+  predicted_runs = predicted[choice];
+
+  std::unique_ptr<Algorithm> chosen{
+      algorithm_factory(auto_candidates[choice], tests.size())};
+  chosen->set_checkpointer(checkpointer);
+  chosen->set_progress(progress);
+  std::unique_ptr<Graph> r{chosen->run(tests, oracle)};
+  truncated = chosen->is_truncated();
+
+  return r;
+}
+
+void Auto::add_metrics(MetricsRow &row) const {
+  row.set("auto_algorithm", choice);
+  row.set("probe_suite_runs", probe_suite_runs);
+  row.set("probe_test_runs", probe_test_runs);
+  row.set("predicted_suite_runs", predicted_runs);
+}
+
+std::unique_ptr<Algorithm> algorithm_factory(const std::string &algo,
+                                             uint32_t tests) {
   if (algo == "pradet")
-    return std::unique_ptr<Algorithm>{new PraDet{}};
+    return specialize<BasicPraDet>(tests,
+                                   std::unique_ptr<Algorithm>{new PraDet{}});
   else if (algo == "pfast")
-    return std::unique_ptr<Algorithm>{new PFAST{}};
+    return specialize<BasicPFAST>(tests,
+                                  std::unique_ptr<Algorithm>{new PFAST{}});
+  else if (algo == "pfast-dd")
+    return std::unique_ptr<Algorithm>{new PFASTDD{}};
   else if (algo == "mem-fast")
-    return std::unique_ptr<Algorithm>{new MEMFAST{}};
+    return specialize<BasicMEMFAST>(tests,
+                                    std::unique_ptr<Algorithm>{new MEMFAST{}});
+  else if (algo == "pradet-batch")
+    return std::unique_ptr<Algorithm>{new PraDetBatch{}};
+  else if (algo == "bisect")
+    return std::unique_ptr<Algorithm>{new Bisect{}};
+  else if (algo == "auto")
+    return std::unique_ptr<Algorithm>{new Auto{}};
   std::cerr << algo
             << " is not a valid method to find dependencies between tests."
             << std::endl;
   exit(EXIT_FAILURE);
 }
+
+// The overhead of a run, starting the process and writing its results
+static const uint64_t run_overhead_us = 5000;
+
+uint64_t estimate_cost(const std::string &algo, uint32_t tests) {
+  // The microseconds of a run on a hundred tests, measured on the
+  // generated graphs, growing about with the cube of the size
+  uint64_t per_hundred;
+
+  if (algo == "pradet")
+    per_hundred = 6000;
+  else if (algo == "pfast")
+    per_hundred = 200;
+  else if (algo == "pfast-dd" || algo == "auto")
+    per_hundred = 18000;
+  else if (algo == "mem-fast")
+    per_hundred = 16000000;
+  else if (algo == "pradet-batch")
+    per_hundred = 80000;
+  else if (algo == "bisect")
+    per_hundred = 30000;
+  else {
+    std::cerr << algo
+              << " is not a valid method to find dependencies between tests."
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  return run_overhead_us +
+         per_hundred * (uint64_t)tests * tests * tests / 1000000;
+}
@@ -2,63 +2,357 @@
 
 #define ALGORITHMS_H_INCLUDED
 
+#include "checkpoint.h"
 #include "graph.h"
+#include "metrics.h"
+#include "progress.h"
+#include "schedule-kernels.h"
 #include "test-suite-oracle.h"
 #include <cstdint>
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 typedef std::vector<uint32_t> schedule;
+typedef std::set<schedule, ScheduleLess> schedule_set;
 
 class Algorithm {
 public:
+  Algorithm(void)
+      : checkpointer{nullptr}, progress{nullptr}, truncated{false} {}
   virtual ~Algorithm(void) {};
   virtual std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
                                      TestSuiteOracle *oracle) = 0;
+
+  inline void set_checkpointer(Checkpointer *c) { checkpointer = c; }
+  // The gauges the run publishes as it goes, for a heartbeat.
+  inline void set_progress(Progress *p) { progress = p; }
+
+  // Whether the last run stopped because the oracle budget was exhausted.
+  // A truncated run returns a graph that keeps every dependency that was
+  // not disproved yet, so its schedules are still safe to run.
+  inline bool is_truncated(void) const { return truncated; }
+
+  // Adds the columns particular to the algorithm to the metrics of its
+  // last run.
+  virtual void add_metrics(MetricsRow &row) const {}
+
+protected:
+  Checkpointer *checkpointer;
+  Progress *progress;
+  bool truncated;
 };
 
-class PFAST : public Algorithm {
+// PFAST, PraDet and MEMFAST are templates over the graph G they fill, over
+// the positions of the tests in the suite, and over the oracle O they ask,
+// which run must be given. The instantiations below handle any suite, and
+// static-algorithms.h instantiates them on fixed bitsets for small ones.
+template <class G, class O> class BasicPFAST : public Algorithm {
 public:
   std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
                              TestSuiteOracle *oracle);
+
+private:
+  // The search of the dependents of the i-th test, with the schedule of
+  // its next run: the suite without the i-th test and the dependents found
+  // so far.
+  class Probe {
+  public:
+    uint32_t i;
+    ScheduleView schedule;
+  };
 };
 
-class PraDet : public Algorithm {
+typedef BasicPFAST<Graph, TestSuiteOracle> PFAST;
+
+// PFAST searching the dependents of the tests from the last one back. By
+// the time the i-th test is searched, the dependents of the tests after it
+// are known, so a test failing without the i-th one brings all of its own
+// dependents along without running them. The tests that passed leave the
+// next runs, which keep only the tests the remaining candidates depend on,
+// so the runs get shorter as the search goes. It finds the same
+// dependencies as PFAST.
+class PFASTDD : public Algorithm {
 public:
   std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
                              TestSuiteOracle *oracle);
+
+private:
+  class Context {
+  public:
+    Context(const std::vector<uint32_t> &tests, TestSuiteOracle *oracle);
+
+  private:
+    friend class PFASTDD;
+
+    const std::vector<uint32_t> &tests;
+    TestSuiteOracle *oracle;
+    // The edge (t, j) when the t-th test depends on the j-th one, directly
+    // or not, over the positions of the tests in the suite
+    BitMatrix closures;
+    // The transpose of closures, with the dependents of each test
+    BitMatrix dependents;
+    // The dependents found for the current test and the tests of its next
+    // run after it, as bits
+    std::vector<uint64_t> found;
+    std::vector<uint64_t> needed;
+    // The position of each test of the schedule after the current one
+    std::vector<uint32_t> positions;
+    schedule sched;
+    bool truncated;
+  };
+
+  static void find_dependents(Context &ctx, uint32_t i);
 };
 
-class MEMFAST : public Algorithm {
+template <class G, class O> class BasicPraDet : public Algorithm {
+public:
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle);
+};
+
+typedef BasicPraDet<BitMatrix, TestSuiteOracle> PraDet;
+
+// PraDet testing many edges per run. Each batch inverts edges that share no
+// test and keep the graph acyclic, and runs the union of their schedules
+// in topological order. An edge whose dependent test passes before the
+// first failure is not a dependency. When the run fails, the undecided
+// edges are split in halves and retried, down to single edges that are
+// decided like in PraDet.
+class PraDetBatch : public Algorithm {
 public:
   std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
                              TestSuiteOracle *oracle);
 
 private:
+  typedef std::vector<std::pair<uint32_t, uint32_t>> edge_list;
+
   class Context {
   public:
-    explicit Context(const std::vector<uint32_t> &tests,
-                     TestSuiteOracle *oracle);
+    Context(const std::vector<uint32_t> &tests, TestSuiteOracle *oracle);
+
+    uint32_t run_batch(const edge_list &batch);
+    void add_edge(uint32_t u, uint32_t v);
+    void remove_edge(uint32_t u, uint32_t v);
+    bool reaches(uint32_t u, uint32_t v);
+
+  private:
+    friend class PraDetBatch;
+
+    const std::vector<uint32_t> &tests;
+    TestSuiteOracle *oracle;
+    // The graph is a bit matrix over the positions of the sorted tests
+    std::vector<uint32_t> nodes;
+    // The position of each test of the suite
+    std::vector<uint32_t> positions;
+    BitMatrix m;
+    // The transpose of m, to find the paths of two edges quickly
+    BitMatrix reversed;
+    // The edges (u, v) removed or kept for good
+    BitMatrix decided;
+    uint32_t progress;
+    std::vector<uint64_t> deps;
+    std::vector<uint32_t> path;
+    std::vector<uint8_t> state;
+    std::vector<uint32_t> order;
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    schedule sched;
+    bool truncated;
+  };
+
+  static bool try_invert(Context &ctx, const std::pair<uint32_t, uint32_t> &e);
+  static edge_list pick_batch(Context &ctx, EdgeWorklist &pending,
+                              uint32_t limit);
+  static edge_list invert_batch(Context &ctx, const edge_list &edges);
+  static void decide(Context &ctx, edge_list &&batch);
+};
+
+template <class G, class O> class BasicMEMFAST : public Algorithm {
+public:
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle);
+
+private:
+  enum class Stage : uint32_t { append, candidates, passing };
+
+  // A failed test appended to a passing schedule, running.
+  class Probe {
+  public:
+    uint32_t test;
+    bool fresh;
+  };
+
+  // The point of the search a checkpoint resumes from: the loops of the
+  // given stage restart from the schedules they were visiting when the
+  // checkpoint was taken.
+  class Position {
+  public:
+    Position(Stage stage, uint32_t rank, uint32_t prefix_len);
 
+    Stage stage;
+    uint32_t rank;
+    uint32_t prefix_len;
+    uint32_t base;
+    uint32_t idx;
+    schedule s1;
+    schedule s2;
+    schedule_set passing;
+    schedule_set new_passing;
+  };
+
+  class Context {
+  public:
+    explicit Context(const std::vector<uint32_t> &tests, O *oracle);
+
+    void run_single_tests(void);
     std::vector<bool> run_schedule(const schedule &schedule);
+    bool submit_schedule(const schedule &schedule, uint64_t &ticket,
+                         bool &fresh);
+    void record_schedule(const schedule &schedule,
+                         const std::vector<bool> &result, bool fresh);
     bool runned_schedule(const schedule &schedule);
+    void add_edge(uint32_t u, uint32_t v);
 
   private:
-    friend class MEMFAST;
+    friend class BasicMEMFAST;
 
+    const std::vector<uint32_t> &tests;
     std::set<uint32_t> failed;
-    std::unique_ptr<Graph> graph;
+    // The graph is over the positions of the tests, while the schedules
+    // and the failed tests hold their ids
+    std::unordered_map<uint32_t, uint32_t> positions;
+    G graph;
     uint32_t max;
-    TestSuiteOracle *oracle;
-    std::set<schedule> runned;
-    std::vector<std::set<schedule>> table;
+    O *oracle;
+    schedule_set runned;
+    std::vector<schedule_set> table;
+    std::unique_ptr<Position> resume;
+    bool truncated;
   };
 
   void append_failed_tests(Context &ctx, uint32_t rank);
   void extensive_search(Context &ctx, uint32_t rank, uint32_t prefix_len);
-  static schedule merge_schedules(const schedule &s1, const schedule &s2);
+  void save_checkpoint(Context &ctx, const Position &pos);
+  void restore_checkpoint(Context &ctx, CheckpointReader &reader);
+};
+
+typedef BasicMEMFAST<Graph, TestSuiteOracle> MEMFAST;
+
+// Finds the dependencies of each test by adaptive group testing: the test
+// runs after a prefix of the tests before it, binary searching the
+// shortest prefix that lets it pass. The last test of that prefix is a
+// dependency, and the search repeats on shorter prefixes until the
+// dependencies found so far let the test pass on their own. A test with d
+// dependencies takes about d log n runs. Like the other algorithms, it
+// expects the tests to pass in the order of the suite.
+class Bisect : public Algorithm {
+public:
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle);
+
+protected:
+  class Context {
+  public:
+    Context(const std::vector<uint32_t> &tests, TestSuiteOracle *oracle);
+
+    bool run_after(uint32_t i, uint32_t prefix);
+    void store_closure(uint32_t i);
+
+  private:
+    friend class Bisect;
+    friend class Incremental;
+
+    const std::vector<uint32_t> &tests;
+    TestSuiteOracle *oracle;
+    // The positions of the tests each test depends on, directly or not
+    std::vector<std::vector<uint32_t>> closures;
+    // The positions of the dependencies found for the current test
+    std::vector<uint32_t> found;
+    std::vector<bool> marked;
+    schedule sched;
+    bool truncated;
+  };
+
+  void find_dependencies(Context &ctx, uint32_t i);
+  // Makes the i-th test depend on every test before it, and each later
+  // test on the one before it, for a run stopped at the i-th test.
+  static void chain_from(Graph &r, const std::vector<uint32_t> &tests,
+                         uint32_t i);
 };
 
-std::unique_ptr<Algorithm> algorithm_factory(const std::string &algo);
+// Updates the graph found by an earlier run for a changed suite. The tests
+// that are still in the suite keep their dependencies from the previous
+// graph, as long as they still pass after just those: a few confirmation
+// runs check that. Each dependency kept is then checked by running its
+// test without it, which drops the ones that no longer hold. Only the new
+// tests and the ones that fail their confirmation are searched again, like
+// in Bisect. When they are too many, or when the update is on course to
+// take more runs than a full search, the whole suite is searched with the
+// given algorithm instead.
+class Incremental : public Bisect {
+public:
+  Incremental(const Graph &previous, std::unique_ptr<Algorithm> &&full);
+
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle);
+  void add_metrics(MetricsRow &row) const override;
+
+private:
+  void reuse_closures(Context &ctx, std::vector<bool> &redo);
+  void confirm(Context &ctx, std::vector<bool> &redo,
+               std::vector<bool> &confirmed);
+  void drop_stale(Context &ctx, uint32_t i,
+                  const std::vector<std::vector<uint32_t>> &direct);
+  std::unique_ptr<Graph> search_all(const std::vector<uint32_t> &tests,
+                                    TestSuiteOracle *oracle);
+
+  Graph previous;
+  std::unique_ptr<Algorithm> full;
+  // Whether the last run searched the whole suite with full
+  bool searched_all;
+};
+
+// Picks the algorithm expected to take the fewest runs on the suite among
+// PFAST, PFAST-DD, PraDet and MEM-FAST, then runs it. A few probes, each
+// running the suite without one test like the first run of PFAST, estimate
+// how many pairs of tests depend on each other and how many tests have
+// dependents. A cost model fitted on local runs of generated suites, not
+// on the stats.csv files of the experiments, turns those into the runs of
+// each algorithm, counting the runs that PFAST keeps in flight together as
+// one. A resumed run probes again, on top of the runs of the checkpoint,
+// and the algorithm picked resumes from the checkpoint if it wrote it.
+class Auto : public Algorithm {
+public:
+  Auto(void);
+
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle);
+  void add_metrics(MetricsRow &row) const override;
+
+private:
+  // The share of the pairs of tests where the later test depends on the
+  // earlier one, and the share of the tests with dependents
+  class Estimate {
+  public:
+    double share;
+    double hubs;
+  };
+
+  Estimate probe(const std::vector<uint32_t> &tests, TestSuiteOracle *oracle);
+
+  uint32_t choice;
+  uint64_t probe_suite_runs;
+  uint64_t probe_test_runs;
+  uint64_t predicted_runs;
+};
+
+// Suites of up to 1024 tests get an implementation specialized at compile
+// time on their size, see static-algorithms.h.
+std::unique_ptr<Algorithm> algorithm_factory(const std::string &algo,
+                                             uint32_t tests);
+
+// A rough estimate of the microseconds a run of the given algorithm takes
+// on a suite of the given size, to balance experiments among machines.
+uint64_t estimate_cost(const std::string &algo, uint32_t tests);
 
 #endif
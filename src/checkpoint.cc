@@ -0,0 +1,288 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static const char checkpoint_magic[] = "STSC";
+static const uint64_t checkpoint_version = 1;
+
+static uint64_t tests_fingerprint(const std::vector<uint32_t> &tests) {
+  uint64_t h{14695981039346656037ULL};
+
+  for (const uint32_t t : tests) {
+    h ^= t;
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (v >> 63); }
+
+static int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(v & 1); }
+
+void CheckpointWriter::put(uint64_t v) {
+  while (v >= 0x80) {
+    buf.push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  buf.push_back((char)v);
+}
+
+void CheckpointWriter::put(const std::string &s) {
+  put(s.size());
+  buf += s;
+}
+
+void CheckpointWriter::put(const std::vector<uint32_t> &v) {
+  int64_t prev{0};
+
+  put(v.size());
+  for (const uint32_t x : v) {
+    put(zigzag((int64_t)x - prev));
+    prev = x;
+  }
+}
+
+void CheckpointWriter::put(const std::set<uint32_t> &s) {
+  uint32_t prev{0};
+
+  put(s.size());
+  for (const uint32_t x : s) {
+    put(x - prev);
+    prev = x;
+  }
+}
+
+void CheckpointWriter::put(
+    const std::set<std::vector<uint32_t>, ScheduleLess> &s) {
+  static const std::vector<uint32_t> none;
+  const std::vector<uint32_t> *prev{&none};
+
+  put(s.size());
+  for (const auto &sched : s) {
+    put_schedule(sched, *prev);
+    prev = &sched;
+  }
+}
+
+template <class S>
+void CheckpointWriter::put_schedule(const S &sched,
+                                    const std::vector<uint32_t> &prev) {
+  auto it = sched.begin();
+  uint32_t common{0};
+
+  while (common < prev.size() && it != sched.end() && prev[common] == *it) {
+    ++common;
+    ++it;
+  }
+
+  put(common);
+  put(sched.size() - common);
+  int64_t last = common ? prev[common - 1] : 0;
+  for (; it != sched.end(); ++it) {
+    put(zigzag((int64_t)*it - last));
+    last = *it;
+  }
+}
+
+template void
+CheckpointWriter::put_schedule(const std::vector<uint32_t> &sched,
+                               const std::vector<uint32_t> &prev);
+template void CheckpointWriter::put_schedule(const ScheduleView &sched,
+                                             const std::vector<uint32_t> &prev);
+
+void CheckpointWriter::put(const Graph &g) {
+  std::vector<uint32_t> nodes;
+
+  for (const auto &it : g)
+    nodes.push_back(it.first);
+  put(nodes);
+
+  for (const auto &it : g)
+    put(std::set<uint32_t>{it.second.begin(), it.second.end()});
+}
+
+CheckpointReader::CheckpointReader(std::string &&data)
+    : buf{std::move(data)}, pos{0}, good{true} {}
+
+uint64_t CheckpointReader::get(void) {
+  uint64_t v{0};
+
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (pos >= buf.size()) {
+      good = false;
+      return 0;
+    }
+    uint8_t byte = buf[pos++];
+    v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return v;
+  }
+
+  good = false;
+  return 0;
+}
+
+std::string CheckpointReader::get_string(void) {
+  uint64_t len = get();
+
+  if (!good || pos + len > buf.size()) {
+    good = false;
+    return std::string{};
+  }
+
+  std::string s = buf.substr(pos, len);
+  pos += len;
+  return s;
+}
+
+std::vector<uint32_t> CheckpointReader::get_vector(void) {
+  uint64_t len = get();
+  std::vector<uint32_t> v;
+  int64_t prev{0};
+
+  for (uint64_t i = 0; good && i < len; ++i) {
+    prev += unzigzag(get());
+    v.push_back(prev);
+  }
+
+  return v;
+}
+
+std::set<uint32_t> CheckpointReader::get_set(void) {
+  uint64_t len = get();
+  std::set<uint32_t> s;
+  uint32_t prev{0};
+
+  for (uint64_t i = 0; good && i < len; ++i) {
+    prev += get();
+    s.insert(s.end(), prev);
+  }
+
+  return s;
+}
+
+std::set<std::vector<uint32_t>, ScheduleLess>
+CheckpointReader::get_schedules(void) {
+  uint64_t len = get();
+  std::set<std::vector<uint32_t>, ScheduleLess> s;
+  std::vector<uint32_t> sched;
+
+  for (uint64_t i = 0; good && i < len; ++i) {
+    get_schedule(sched);
+    if (good)
+      s.insert(s.end(), sched);
+  }
+
+  return s;
+}
+
+void CheckpointReader::get_schedule(std::vector<uint32_t> &sched) {
+  uint64_t common = get();
+  uint64_t rest = get();
+
+  if (!good || common > sched.size()) {
+    good = false;
+    return;
+  }
+  sched.resize(common);
+
+  int64_t last = common ? sched[common - 1] : 0;
+  for (uint64_t j = 0; good && j < rest; ++j) {
+    last += unzigzag(get());
+    sched.push_back(last);
+  }
+}
+
+Graph CheckpointReader::get_graph(void) {
+  std::vector<uint32_t> nodes = get_vector();
+  Graph g{nodes};
+
+  for (const uint32_t u : nodes)
+    for (const uint32_t v : get_set())
+      g.add_edge(u, v);
+
+  return g;
+}
+
+Checkpointer::Checkpointer(const std::string &file, uint32_t interval,
+                           bool resume)
+    : file{file}, interval{interval}, last{std::chrono::steady_clock::now()},
+      resume{resume} {}
+
+bool Checkpointer::due(void) {
+  return std::chrono::steady_clock::now() - last >= interval;
+}
+
+CheckpointWriter Checkpointer::begin(const std::string &algorithm,
+                                     const std::vector<uint32_t> &tests,
+                                     const TestSuiteOracle *oracle) const {
+  CheckpointWriter writer;
+
+  writer.put(std::string{checkpoint_magic});
+  writer.put(checkpoint_version);
+  writer.put(algorithm);
+  writer.put(tests.size());
+  writer.put(tests_fingerprint(tests));
+  writer.put(oracle->get_test_suite_runs());
+  writer.put(oracle->get_test_runs());
+
+  return writer;
+}
+
+bool Checkpointer::save(const CheckpointWriter &writer) {
+  std::string tmp{file + ".tmp"};
+  std::ofstream out{tmp, std::ios::binary | std::ios::trunc};
+
+  out.write(writer.data().data(), writer.data().size());
+  out.close();
+  last = std::chrono::steady_clock::now();
+  if (!out || std::rename(tmp.c_str(), file.c_str()) != 0) {
+    std::cerr << "Failed to write checkpoint file \"" << file << '"'
+              << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+std::unique_ptr<CheckpointReader>
+Checkpointer::restore(const std::string &algorithm,
+                      const std::vector<uint32_t> &tests,
+                      TestSuiteOracle *oracle) const {
+  if (!resume)
+    return nullptr;
+
+  std::ifstream is{file, std::ios::binary};
+  if (!is)
+    return nullptr;
+
+  std::unique_ptr<CheckpointReader> reader{new CheckpointReader{
+      std::string{std::istreambuf_iterator<char>{is},
+                  std::istreambuf_iterator<char>{}}}};
+
+  if (reader->get_string() != checkpoint_magic ||
+      reader->get() != checkpoint_version) {
+    std::cerr << '"' << file << '"' << " is not a valid checkpoint file."
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (reader->get_string() != algorithm || reader->get() != tests.size() ||
+      reader->get() != tests_fingerprint(tests)) {
+    std::cerr << "The checkpoint \"" << file << '"'
+              << " was not taken by this algorithm on this test suite."
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t suite_runs = reader->get();
+  uint64_t runs = reader->get();
+  oracle->restore_counters(suite_runs + oracle->get_test_suite_runs(),
+                           runs + oracle->get_test_runs());
+
+  return reader;
+}
+
+void Checkpointer::remove(void) const { std::remove(file.c_str()); }
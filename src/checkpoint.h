@@ -0,0 +1,91 @@
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include "graph.h"
+#include "schedule-kernels.h"
+#include "test-suite-oracle.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Serializes algorithm state into a compact buffer. Integers are stored
+// as varints, sorted sets as deltas, and sets of sorted schedules as the
+// length of the prefix shared with the previous schedule plus the deltas
+// of the remaining tests.
+class CheckpointWriter {
+public:
+  void put(uint64_t v);
+  void put(const std::string &s);
+  void put(const std::vector<uint32_t> &v);
+  void put(const std::set<uint32_t> &s);
+  void put(const std::set<std::vector<uint32_t>, ScheduleLess> &s);
+  void put(const Graph &g);
+  // A schedule, relative to the previous one of a sequence.
+  template <class S>
+  void put_schedule(const S &sched, const std::vector<uint32_t> &prev);
+
+  inline const std::string &data(void) const { return buf; }
+  inline void clear(void) { buf.clear(); }
+
+private:
+  std::string buf;
+};
+
+class CheckpointReader {
+public:
+  explicit CheckpointReader(std::string &&data);
+
+  uint64_t get(void);
+  std::string get_string(void);
+  std::vector<uint32_t> get_vector(void);
+  std::set<uint32_t> get_set(void);
+  std::set<std::vector<uint32_t>, ScheduleLess> get_schedules(void);
+  Graph get_graph(void);
+  // Replaces the previous schedule of a sequence with the next one.
+  void get_schedule(std::vector<uint32_t> &sched);
+
+  inline bool ok(void) const { return good; }
+  inline bool at_end(void) const { return pos == buf.size(); }
+
+private:
+  std::string buf;
+  size_t pos;
+  bool good;
+};
+
+// Decides when an algorithm should save its state and stores it into a
+// file. The file is replaced atomically, so a run killed while saving
+// still finds the previous checkpoint.
+class Checkpointer {
+public:
+  Checkpointer(const std::string &file, uint32_t interval, bool resume);
+
+  // Cheap enough to be called on every iteration of the algorithms, as
+  // each iteration runs at least one test schedule.
+  bool due(void);
+
+  CheckpointWriter begin(const std::string &algorithm,
+                         const std::vector<uint32_t> &tests,
+                         const TestSuiteOracle *oracle) const;
+  bool save(const CheckpointWriter &writer);
+
+  // Returns the saved state of the given algorithm positioned after the
+  // header, or nullptr if there is nothing to resume. The oracle counters
+  // are restored as a side effect, keeping the runs made before the
+  // restore, like the probes of auto.
+  std::unique_ptr<CheckpointReader>
+  restore(const std::string &algorithm, const std::vector<uint32_t> &tests,
+          TestSuiteOracle *oracle) const;
+  void remove(void) const;
+
+private:
+  std::string file;
+  std::chrono::seconds interval;
+  std::chrono::steady_clock::time_point last;
+  bool resume;
+};
+
+#endif
@@ -1,16 +1,24 @@
 #include "graph.h"
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdint>
 #include <iterator>
 #include <random>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 Graph::Graph(const std::vector<uint32_t> &nodes) : graph{} {
   for (const uint32_t &node : nodes)
     graph[node] = std::unordered_set<uint32_t>{};
 }
 
+Graph::Graph(uint32_t n) : graph{} {
+  for (uint32_t u = 0; u < n; ++u)
+    graph[u] = std::unordered_set<uint32_t>{};
+}
+
 void Graph::remove_edge(uint32_t u, uint32_t v) { graph[u].erase(v); }
 
 void Graph::add_edge(uint32_t u, uint32_t v) { graph[u].insert(v); }
@@ -23,6 +31,7 @@ void Graph::invert_edge(uint32_t u, uint32_t v) {
 std::vector<std::vector<uint32_t>> Graph::get_schedules(void) const {
   std::vector<std::vector<uint32_t>> schedules;
   std::unordered_set<uint32_t> visited;
+  std::pmr::unsynchronized_pool_resource scratch;
 
   std::vector<uint32_t> nodes;
   for (const auto &it : graph)
@@ -33,7 +42,7 @@ std::vector<std::vector<uint32_t>> Graph::get_schedules(void) const {
     if (visited.find(*it) != visited.cend())
       continue;
 
-    std::unordered_set<uint32_t> deps{get_dependencies(*it)};
+    std::pmr::unordered_set<uint32_t> deps{get_dependencies(*it, &scratch)};
     std::vector<uint32_t> schedule;
     schedule.push_back(*it);
 
@@ -49,11 +58,10 @@ std::vector<std::vector<uint32_t>> Graph::get_schedules(void) const {
   return schedules;
 }
 
-std::unordered_set<uint32_t> Graph::get_dependencies(uint32_t u) const {
-  std::unordered_set<uint32_t> dep{};
-  std::vector<uint32_t> s{};
-  std::unordered_set<uint32_t> visited{};
-
+template <class Set, class Stack>
+static void collect_dependencies(
+    const std::map<uint32_t, std::unordered_set<uint32_t>> &graph, uint32_t u,
+    Set &dep, Stack &s, Set &visited) {
   s.push_back(u);
 
   while (!s.empty()) {
@@ -67,15 +75,88 @@ std::unordered_set<uint32_t> Graph::get_dependencies(uint32_t u) const {
         dep.insert(i);
     visited.insert(v);
   }
+}
+
+std::unordered_set<uint32_t> Graph::get_dependencies(uint32_t u) const {
+  std::unordered_set<uint32_t> dep{};
+  std::vector<uint32_t> s{};
+  std::unordered_set<uint32_t> visited{};
+
+  collect_dependencies(graph, u, dep, s, visited);
+  return dep;
+}
+
+std::pmr::unordered_set<uint32_t>
+Graph::get_dependencies(uint32_t u, std::pmr::memory_resource *memory) const {
+  std::pmr::unordered_set<uint32_t> dep{memory};
+  std::pmr::vector<uint32_t> s{memory};
+  std::pmr::unordered_set<uint32_t> visited{memory};
+
+  collect_dependencies(graph, u, dep, s, visited);
   return dep;
 }
 
+// Smaller graphs are reduced faster than the threads can be started.
+static const uint64_t parallel_reduction_edges = 4096;
+// The number of chunks of nodes handed out to each thread, so that a few
+// expensive nodes do not leave the other threads idle.
+static const uint32_t reduction_chunks_per_thread = 8;
+
 void Graph::transitive_reduction(void) {
+  std::unordered_map<uint32_t, uint32_t> positions;
+  std::vector<uint32_t> nodes;
+
+  for (const auto &it : graph) {
+    positions.emplace(it.first, nodes.size());
+    nodes.push_back(it.first);
+  }
+
+  PositionGraph g{*this, positions};
+  ReachabilityIndex index{g};
+  if (index.acyclic()) {
+    uint32_t threads = std::min<uint64_t>(std::thread::hardware_concurrency(),
+                                          g.size());
+    std::vector<uint32_t> bounds{0};
+    std::atomic<uint32_t> next{0};
+    std::vector<std::thread> pool;
+
+    // Chunks of consecutive nodes with about the same total degree
+    if (threads > 1 && g.deps.size() >= parallel_reduction_edges) {
+      uint64_t target = (g.deps.size() + g.size()) /
+                            (threads * reduction_chunks_per_thread) +
+                        1;
+      uint64_t weight{0};
+
+      for (uint32_t u = 0; u < g.size(); ++u) {
+        weight += g.offsets[u + 1] - g.offsets[u] + 1;
+        if (weight >= target) {
+          bounds.push_back(u + 1);
+          weight = 0;
+        }
+      }
+    } else {
+      threads = 1;
+    }
+    if (bounds.back() != g.size())
+      bounds.push_back(g.size());
+
+    for (uint32_t i = 1; i < threads; ++i)
+      pool.emplace_back(&Graph::reduce_with_index, this, std::cref(g),
+                        std::cref(index), std::cref(nodes), std::cref(bounds),
+                        std::ref(next));
+    reduce_with_index(g, index, nodes, bounds, next);
+    for (auto &t : pool)
+      t.join();
+    return;
+  }
+
+  // On a cycle, the dependencies are removed in place as they are found
+  std::pmr::unsynchronized_pool_resource scratch;
   for (auto &it : graph) {
     std::unordered_set<uint32_t> min_edges{it.second};
 
     for (uint32_t v : it.second) {
-      std::unordered_set<uint32_t> deps = get_dependencies(v);
+      std::pmr::unordered_set<uint32_t> deps = get_dependencies(v, &scratch);
       for (uint32_t u : it.second)
         if (deps.find(u) != deps.end() && min_edges.find(u) != min_edges.end())
           min_edges.erase(u);
@@ -85,16 +166,488 @@ void Graph::transitive_reduction(void) {
   }
 }
 
+Graph Graph::to_graph(const std::vector<uint32_t> &nodes) const {
+  Graph g{nodes};
+
+  for (const auto &it : graph)
+    for (const uint32_t v : it.second)
+      g.add_edge(nodes[it.first], nodes[v]);
+
+  return g;
+}
+
+// A dependency is redundant when another dependency of the node reaches
+// it. The dependencies are checked from the highest above the leaves down,
+// so that only the ones kept so far need to be asked, since a dependency
+// reaching another is always higher. Each thread takes the next chunk of
+// nodes between two bounds. The index only reads the frozen position graph,
+// so the threads share it, each with its own search, and only write to the
+// edge sets of their own nodes: every node is already in the map, so the
+// lookups never insert.
+void Graph::reduce_with_index(const PositionGraph &g,
+                              const ReachabilityIndex &index,
+                              const std::vector<uint32_t> &nodes,
+                              const std::vector<uint32_t> &bounds,
+                              std::atomic<uint32_t> &next) {
+  ReachabilityIndex::Search search;
+  std::vector<std::pair<uint32_t, uint32_t>> out;
+  std::vector<uint32_t> kept;
+
+  for (uint32_t chunk = next++; chunk + 1 < bounds.size(); chunk = next++)
+    for (uint32_t u = bounds[chunk]; u < bounds[chunk + 1]; ++u) {
+      out.clear();
+      for (uint32_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k)
+        out.emplace_back(index.height(g.deps[k]), g.deps[k]);
+      if (out.size() < 2)
+        continue;
+      std::sort(out.rbegin(), out.rend());
+
+      std::unordered_set<uint32_t> &edges = graph.find(nodes[u])->second;
+      kept.clear();
+      for (const auto &dep : out) {
+        bool redundant{false};
+
+        for (uint32_t i = 0; i < kept.size() && !redundant; ++i)
+          redundant = index.reaches(kept[i], dep.second, search);
+        if (redundant)
+          edges.erase(nodes[dep.second]);
+        else
+          kept.push_back(dep.second);
+      }
+    }
+}
+
+BitMatrix::BitMatrix(uint32_t n)
+    : n{n}, stride{(n + 63) / 64}, bits((size_t)n * stride) {}
+
+bool BitMatrix::meets(uint32_t u, const BitMatrix &other, uint32_t v) const {
+  const uint64_t *a = &bits[(size_t)u * stride];
+  const uint64_t *b = &other.bits[(size_t)v * stride];
+
+  for (uint32_t k = 0; k < stride; ++k)
+    if (a[k] & b[k])
+      return true;
+
+  return false;
+}
+
+uint32_t BitMatrix::next_edge(uint32_t u, uint32_t from) const {
+  if (from >= n)
+    return n;
+
+  const uint64_t *row = &bits[(size_t)u * stride];
+  uint32_t k = from >> 6;
+  uint64_t w = row[k] & (~(uint64_t)0 << (from & 63));
+
+  while (!w) {
+    if (++k == stride)
+      return n;
+    w = row[k];
+  }
+
+  return (k << 6) + std::countr_zero(w);
+}
+
+void BitMatrix::merge_row(uint32_t u, std::vector<uint64_t> &words) const {
+  const uint64_t *row = &bits[(size_t)u * stride];
+
+  for (uint32_t k = 0; k < stride; ++k)
+    words[k] |= row[k];
+}
+
+void BitMatrix::dependencies(uint32_t u, std::vector<uint64_t> &deps) const {
+  std::vector<uint64_t> todo{bits.begin() + (size_t)u * stride,
+                             bits.begin() + (size_t)(u + 1) * stride};
+  uint32_t k{0};
+
+  deps = todo;
+  while (true) {
+    while (k < stride && !todo[k])
+      ++k;
+    if (k == stride)
+      break;
+
+    uint32_t v = (k << 6) + std::countr_zero(todo[k]);
+    const uint64_t *row = &bits[(size_t)v * stride];
+
+    todo[k] &= todo[k] - 1;
+    for (uint32_t i = 0; i < stride; ++i) {
+      uint64_t found = row[i] & ~deps[i];
+      if (found) {
+        deps[i] |= found;
+        todo[i] |= found;
+        if (i < k)
+          k = i;
+      }
+    }
+  }
+}
+
+bool BitMatrix::reaches(uint32_t u, uint32_t v, std::vector<uint64_t> &seen,
+                        std::vector<uint32_t> &stack) const {
+  if (has_edge(u, v))
+    return true;
+
+  seen.assign(stride, 0);
+  stack.assign(1, u);
+  while (!stack.empty()) {
+    const uint64_t *row = &bits[(size_t)stack.back() * stride];
+
+    stack.pop_back();
+    // Test each new position as it is found, which settles the usual
+    // case of a short path without visiting the rest of the row
+    for (uint32_t k = 0; k < stride; ++k)
+      for (uint64_t w = row[k] & ~seen[k]; w; w &= w - 1) {
+        uint32_t x = (k << 6) + std::countr_zero(w);
+
+        if (has_edge(x, v))
+          return true;
+        seen[k] |= w & -w;
+        stack.push_back(x);
+      }
+  }
+
+  return false;
+}
+
+void BitMatrix::transitive_reduction(void) {
+  std::vector<uint64_t> deps((size_t)n * stride);
+  std::vector<uint64_t> row;
+
+  for (uint32_t u = 0; u < n; ++u) {
+    dependencies(u, row);
+    std::copy(row.begin(), row.end(), deps.begin() + (size_t)u * stride);
+  }
+
+  std::vector<uint64_t> redundant(stride);
+  for (uint32_t u = 0; u < n; ++u) {
+    uint64_t *out = &bits[(size_t)u * stride];
+
+    std::fill(redundant.begin(), redundant.end(), 0);
+    for (uint32_t k = 0; k < stride; ++k)
+      for (uint64_t w = out[k]; w; w &= w - 1) {
+        uint32_t v = (k << 6) + std::countr_zero(w);
+        for (uint32_t i = 0; i < stride; ++i)
+          redundant[i] |= deps[(size_t)v * stride + i];
+      }
+
+    for (uint32_t k = 0; k < stride; ++k)
+      out[k] &= ~redundant[k];
+  }
+}
+
+Graph BitMatrix::to_graph(const std::vector<uint32_t> &nodes) const {
+  Graph g{nodes};
+
+  for (uint32_t u = 0; u < n; ++u)
+    for (uint32_t k = 0; k < stride; ++k)
+      for (uint64_t w = bits[(size_t)u * stride + k]; w; w &= w - 1)
+        g.add_edge(nodes[u], nodes[(k << 6) + std::countr_zero(w)]);
+
+  return g;
+}
+
+EdgeWorklist::EdgeWorklist(std::vector<std::pair<uint32_t, uint32_t>> &&edges)
+    : edges{std::move(edges)}, removed(this->edges.size()), cursor{0},
+      live{(uint32_t)this->edges.size()} {}
+
+void EdgeWorklist::advance(void) {
+  if (live == 0)
+    return;
+
+  do {
+    if (++cursor == edges.size())
+      cursor = 0;
+  } while (removed[cursor]);
+}
+
+void EdgeWorklist::erase(void) {
+  removed[cursor] = true;
+  --live;
+  advance();
+  if (edges.size() - live > live)
+    compact();
+}
+
+void EdgeWorklist::seek(const std::pair<uint32_t, uint32_t> &edge) {
+  cursor = 0;
+  for (uint32_t i = 0; i < edges.size(); ++i)
+    if (!removed[i] && edges[i] == edge) {
+      cursor = i;
+      return;
+    }
+
+  if (live && removed[cursor])
+    advance();
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> EdgeWorklist::remaining(void) const {
+  std::vector<std::pair<uint32_t, uint32_t>> r;
+
+  r.reserve(live);
+  for (uint32_t i = 0; i < edges.size(); ++i)
+    if (!removed[i])
+      r.push_back(edges[i]);
+
+  return r;
+}
+
+void EdgeWorklist::compact(void) {
+  uint32_t j{0}, new_cursor{0};
+
+  for (uint32_t i = 0; i < edges.size(); ++i) {
+    if (removed[i])
+      continue;
+    if (i == cursor)
+      new_cursor = j;
+    edges[j++] = edges[i];
+  }
+
+  edges.resize(j);
+  removed.assign(j, false);
+  cursor = new_cursor;
+}
+
 GraphMetrics::GraphMetrics(void) : longest_schedule{0}, total_cost{0} {}
 
+// Measures the schedules of Graph::get_schedules without building them.
+// The positions follow the order of the nodes, so walking them backwards
+// visits the nodes like get_schedules, and a node reached from a later one
+// marks itself with the position of that one instead of going in a set.
 GraphMetrics compute_graph_metrics(const Graph &graph) {
   GraphMetrics res;
-  std::vector<std::vector<uint32_t>> schedules = graph.get_schedules();
+  std::unordered_map<uint32_t, uint32_t> positions;
+
+  for (const auto &it : graph)
+    positions.emplace(it.first, positions.size());
+
+  PositionGraph g{graph, positions};
+  std::vector<uint32_t> reached_from(g.size(), g.size());
+  std::vector<uint32_t> stack;
+
+  for (uint32_t u = g.size(); u-- > 0;) {
+    if (reached_from[u] != g.size())
+      continue;
+
+    uint64_t size{1};
+    stack.assign(1, u);
+    while (!stack.empty()) {
+      uint32_t v = stack.back();
+
+      stack.pop_back();
+      for (uint32_t k = g.offsets[v]; k < g.offsets[v + 1]; ++k)
+        if (reached_from[g.deps[k]] != u) {
+          reached_from[g.deps[k]] = u;
+          stack.push_back(g.deps[k]);
+          ++size;
+        }
+    }
+
+    if (size > res.longest_schedule)
+      res.longest_schedule = size;
+    res.total_cost += size;
+  }
+
+  return res;
+}
+
+GraphAccuracy::GraphAccuracy(void) : exact{0}, missing{0}, spurious{0} {}
+
+// The bytes of the closure blocks of both graphs together
+static const size_t accuracy_block_bytes = (size_t)1 << 26;
+
+PositionGraph::PositionGraph(void) : offsets(1), deps{}, order{} {}
+
+PositionGraph::PositionGraph(
+    const Graph &graph, const std::unordered_map<uint32_t, uint32_t> &positions)
+    : offsets(positions.size() + 1), deps{}, order{} {
+  std::vector<std::vector<uint32_t>> adj(positions.size());
+
+  for (const auto &it : graph) {
+    auto pu = positions.find(it.first);
+    if (pu == positions.end())
+      continue;
+    for (const uint32_t v : it.second) {
+      auto pv = positions.find(v);
+      if (pv != positions.end())
+        adj[pu->second].push_back(pv->second);
+    }
+  }
+
+  for (uint32_t u = 0; u < adj.size(); ++u) {
+    offsets[u + 1] = offsets[u] + adj[u].size();
+    deps.insert(deps.end(), adj[u].begin(), adj[u].end());
+  }
+
+  // Depth-first post-order, without recursion for deep graphs
+  std::vector<uint8_t> state(adj.size());
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  for (uint32_t root = 0; root < adj.size(); ++root) {
+    if (state[root])
+      continue;
+    state[root] = 1;
+    stack.emplace_back(root, offsets[root]);
+    while (!stack.empty()) {
+      uint32_t u = stack.back().first;
+      if (stack.back().second == offsets[u + 1]) {
+        order.push_back(u);
+        stack.pop_back();
+        continue;
+      }
+      uint32_t v = deps[stack.back().second++];
+      if (!state[v]) {
+        state[v] = 1;
+        stack.emplace_back(v, offsets[v]);
+      }
+    }
+  }
+}
+
+ReachabilityIndex::Search::Search(void) : seen{}, stack{}, stamp{0} {}
+
+// Ranks the nodes in the post-order of a depth-first traversal, starting
+// from the roots and following the dependencies of each node in their
+// order, or both in reverse, and stores the smallest rank below each node.
+// The graph is acyclic, so the dependencies of a node are ranked first.
+static void label_traversal(const PositionGraph &g, bool reverse,
+                            std::vector<uint32_t> &ranks,
+                            std::vector<uint32_t> &lows) {
+  uint32_t n = g.size(), rank{0};
+  std::vector<uint8_t> state(n);
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+  ranks.assign(n, 0);
+  lows.assign(n, 0);
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t root = reverse ? n - 1 - i : i;
+    if (state[root])
+      continue;
+    state[root] = 1;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+      uint32_t u = stack.back().first;
+      uint32_t degree = g.offsets[u + 1] - g.offsets[u];
+
+      if (stack.back().second == degree) {
+        lows[u] = rank;
+        for (uint32_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k)
+          lows[u] = std::min(lows[u], lows[g.deps[k]]);
+        ranks[u] = rank++;
+        stack.pop_back();
+        continue;
+      }
+
+      uint32_t k = stack.back().second++;
+      uint32_t v =
+          g.deps[reverse ? g.offsets[u + 1] - 1 - k : g.offsets[u] + k];
+      if (!state[v]) {
+        state[v] = 1;
+        stack.emplace_back(v, 0);
+      }
+    }
+  }
+}
+
+ReachabilityIndex::ReachabilityIndex(const PositionGraph &graph)
+    : graph{graph}, cyclic{false}, heights(graph.size()), ranks{}, lows{} {
+  // In the order of the PositionGraph, every node comes after its
+  // dependencies unless the graph has a cycle
+  std::vector<uint32_t> index(graph.size());
+  for (uint32_t i = 0; i < graph.order.size(); ++i)
+    index[graph.order[i]] = i;
+
+  for (const uint32_t u : graph.order)
+    for (uint32_t k = graph.offsets[u]; k < graph.offsets[u + 1]; ++k) {
+      uint32_t v = graph.deps[k];
+      if (index[v] >= index[u])
+        cyclic = true;
+      heights[u] = std::max(heights[u], heights[v] + 1);
+    }
 
-  for (const auto &schedule : schedules) {
-    if (schedule.size() > res.longest_schedule)
-      res.longest_schedule = schedule.size();
-    res.total_cost += schedule.size();
+  if (cyclic)
+    return;
+  for (uint32_t t = 0; t < traversals; ++t)
+    label_traversal(graph, t % 2, ranks[t], lows[t]);
+}
+
+bool ReachabilityIndex::reaches(uint32_t u, uint32_t v, Search &search) const {
+  if (!may_reach(u, v))
+    return false;
+
+  if (search.seen.size() != graph.size() || ++search.stamp == 0) {
+    search.seen.assign(graph.size(), 0);
+    search.stamp = 1;
+  }
+  search.stack.assign(1, u);
+  while (!search.stack.empty()) {
+    uint32_t x = search.stack.back();
+
+    search.stack.pop_back();
+    for (uint32_t k = graph.offsets[x]; k < graph.offsets[x + 1]; ++k) {
+      uint32_t y = graph.deps[k];
+
+      if (y == v)
+        return true;
+      if (search.seen[y] != search.stamp && may_reach(y, v)) {
+        search.seen[y] = search.stamp;
+        search.stack.push_back(y);
+      }
+    }
+  }
+
+  return false;
+}
+
+// Stores into block the words [first, first + words) of the closure row of
+// every node.
+static void closure_block(const PositionGraph &g, uint32_t first,
+                          uint32_t words, std::vector<uint64_t> &block) {
+  uint32_t lo = first << 6, hi = (first + words) << 6;
+
+  for (const uint32_t u : g.order) {
+    uint64_t *row = &block[(size_t)u * words];
+
+    std::fill(row, row + words, 0);
+    for (uint32_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k) {
+      uint32_t v = g.deps[k];
+      const uint64_t *dep = &block[(size_t)v * words];
+
+      for (uint32_t i = 0; i < words; ++i)
+        row[i] |= dep[i];
+      if (v >= lo && v < hi)
+        row[(v - lo) >> 6] |= (uint64_t)1 << (v & 63);
+    }
+  }
+}
+
+GraphAccuracy compute_graph_accuracy(const Graph &reference,
+                                     const Graph &result) {
+  GraphAccuracy res;
+  std::unordered_map<uint32_t, uint32_t> positions;
+
+  for (const auto &it : reference)
+    positions.emplace(it.first, positions.size());
+
+  uint32_t n = positions.size();
+  uint32_t stride = (n + 63) / 64;
+  if (n == 0)
+    return res;
+
+  PositionGraph expected{reference, positions}, found{result, positions};
+  uint32_t words = std::clamp<size_t>(
+      accuracy_block_bytes / (2 * sizeof(uint64_t) * n), 1, stride);
+  std::vector<uint64_t> a((size_t)n * words), b((size_t)n * words);
+
+  for (uint32_t first = 0; first < stride; first += words) {
+    uint32_t w = std::min(words, stride - first);
+
+    closure_block(expected, first, w, a);
+    closure_block(found, first, w, b);
+    for (size_t i = 0; i < (size_t)n * w; ++i) {
+      res.exact += std::popcount(a[i] & b[i]);
+      res.missing += std::popcount(a[i] & ~b[i]);
+      res.spurious += std::popcount(b[i] & ~a[i]);
+    }
   }
 
   return res;
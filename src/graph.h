@@ -1,25 +1,42 @@
 #ifndef GRAPH_H_INCLUDED
 #define GRAPH_H_INCLUDED
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory_resource>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+class PositionGraph;
+class ReachabilityIndex;
+
 class Graph {
 public:
   friend std::istream &operator>>(std::istream &, Graph &);
 
   Graph(const std::vector<uint32_t> &nodes);
+  // The graph over the positions 0..n-1 of the nodes of another one, for
+  // the algorithms that work on positions.
+  explicit Graph(uint32_t n);
   Graph(void) : graph{} {};
 
   void add_edge(uint32_t u, uint32_t v);
   void invert_edge(uint32_t u, uint32_t v);
   void remove_edge(uint32_t u, uint32_t v);
   std::unordered_set<uint32_t> get_dependencies(uint32_t u) const;
+  // The same, with the set and the traversal taking their memory from the
+  // given resource, so that a loop can recycle it from a pool.
+  std::pmr::unordered_set<uint32_t>
+  get_dependencies(uint32_t u, std::pmr::memory_resource *memory) const;
   std::vector<std::vector<uint32_t>> get_schedules(void) const;
   void transitive_reduction(void);
+  // The graph over the given nodes of a graph over positions, where the
+  // node at position i is nodes[i].
+  Graph to_graph(const std::vector<uint32_t> &nodes) const;
 
   inline std::map<uint32_t, std::unordered_set<uint32_t>>::iterator
   begin(void) {
@@ -45,8 +62,177 @@ public:
     return graph.size();
   };
 
+  inline bool has_node(uint32_t u) const {
+    return graph.find(u) != graph.end();
+  };
+
 protected:
   std::map<uint32_t, std::unordered_set<uint32_t>> graph;
+
+private:
+  void reduce_with_index(const PositionGraph &g, const ReachabilityIndex &index,
+                         const std::vector<uint32_t> &nodes,
+                         const std::vector<uint32_t> &bounds,
+                         std::atomic<uint32_t> &next);
+};
+
+// A dense adjacency matrix over the positions 0..n-1 of the nodes of a
+// graph, with one bit per edge.
+class BitMatrix {
+public:
+  // The words of a row, as filled by dependencies
+  typedef std::vector<uint64_t> Row;
+
+  explicit BitMatrix(uint32_t n);
+
+  inline uint32_t size(void) const { return n; }
+  inline uint32_t words(void) const { return stride; }
+
+  inline void add_edge(uint32_t u, uint32_t v) {
+    bits[(size_t)u * stride + (v >> 6)] |= (uint64_t)1 << (v & 63);
+  }
+
+  inline void remove_edge(uint32_t u, uint32_t v) {
+    bits[(size_t)u * stride + (v >> 6)] &= ~((uint64_t)1 << (v & 63));
+  }
+
+  inline void invert_edge(uint32_t u, uint32_t v) {
+    remove_edge(u, v);
+    add_edge(v, u);
+  }
+
+  inline bool has_edge(uint32_t u, uint32_t v) const {
+    return bits[(size_t)u * stride + (v >> 6)] >> (v & 63) & 1;
+  }
+
+  // Whether some position w has an edge u -> w here and an edge v -> w in
+  // other, a matrix of the same size.
+  bool meets(uint32_t u, const BitMatrix &other, uint32_t v) const;
+
+  // The first position v >= from with an edge u -> v, or size() if none.
+  uint32_t next_edge(uint32_t u, uint32_t from) const;
+  // Sets in words, a vector of words() words, the positions of the edges
+  // of u.
+  void merge_row(uint32_t u, std::vector<uint64_t> &words) const;
+
+  // Stores into deps the words() words of the positions reachable from u,
+  // with the same semantics as Graph::get_dependencies.
+  void dependencies(uint32_t u, std::vector<uint64_t> &deps) const;
+  // Whether v is among the dependencies of u, stopping the traversal as
+  // soon as it is found. seen and stack are scratch space.
+  bool reaches(uint32_t u, uint32_t v, std::vector<uint64_t> &seen,
+               std::vector<uint32_t> &stack) const;
+  void transitive_reduction(void);
+
+  // The graph over the given nodes, where the node at position i is
+  // nodes[i].
+  Graph to_graph(const std::vector<uint32_t> &nodes) const;
+
+private:
+  uint32_t n;
+  uint32_t stride;
+  std::vector<uint64_t> bits;
+};
+
+// An ordered list of edges visited round-robin. Removing an edge leaves a
+// tombstone that the cursor skips, and the list is compacted once the
+// tombstones outnumber the live edges, so the edges keep their initial
+// relative order.
+class EdgeWorklist {
+public:
+  explicit EdgeWorklist(std::vector<std::pair<uint32_t, uint32_t>> &&edges);
+
+  inline bool empty(void) const { return live == 0; }
+  inline uint32_t size(void) const { return live; }
+  inline const std::pair<uint32_t, uint32_t> &current(void) const {
+    return edges[cursor];
+  }
+
+  // Moves the cursor to the next live edge, wrapping around at the end.
+  void advance(void);
+  // Removes the current edge and moves the cursor to the next live edge.
+  void erase(void);
+  // Moves the cursor to the given edge, or to the first live edge if the
+  // edge is not in the list.
+  void seek(const std::pair<uint32_t, uint32_t> &edge);
+  std::vector<std::pair<uint32_t, uint32_t>> remaining(void) const;
+
+private:
+  void compact(void);
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  std::vector<bool> removed;
+  uint32_t cursor;
+  uint32_t live;
+};
+
+// The direct dependencies of each node of a graph, as positions among the
+// given nodes, stored contiguously, and an order of the positions where
+// every node comes after its dependencies. Built once in O(n + m), it
+// takes a few bytes per node and edge, and walking it needs no hashing.
+class PositionGraph {
+public:
+  explicit PositionGraph(void);
+  PositionGraph(const Graph &graph,
+                const std::unordered_map<uint32_t, uint32_t> &positions);
+
+  inline uint32_t size(void) const { return offsets.size() - 1; }
+
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> deps;
+  std::vector<uint32_t> order;
+};
+
+// Answers whether a node reaches another over the positions of a frozen
+// PositionGraph, in the manner of GRAIL. Each traversal of the graph gives
+// every node an interval, from the smallest post-order rank below it to its
+// own rank, and a node reaches another only if its intervals contain the
+// intervals of the other and it is higher above the leaves. That settles
+// most unreachable pairs at once, and the rest with a depth-first search
+// pruned by the same test. Built in O(n + m), it takes a few words per
+// node. On a cyclic graph the intervals do not hold, and the search visits
+// every dependency.
+class ReachabilityIndex {
+public:
+  static const uint32_t traversals = 2;
+
+  // The scratch space of the searches, reused by the queries of a thread.
+  class Search {
+  public:
+    explicit Search(void);
+
+    std::vector<uint32_t> seen;
+    std::vector<uint32_t> stack;
+    uint32_t stamp;
+  };
+
+  explicit ReachabilityIndex(const PositionGraph &graph);
+
+  inline bool acyclic(void) const { return !cyclic; }
+  inline uint32_t height(uint32_t u) const { return heights[u]; }
+
+  // Whether v is among the dependencies of u, with the same semantics as
+  // Graph::get_dependencies.
+  bool reaches(uint32_t u, uint32_t v, Search &search) const;
+
+private:
+  inline bool may_reach(uint32_t u, uint32_t v) const {
+    if (cyclic)
+      return true;
+    if (heights[u] <= heights[v])
+      return false;
+    for (uint32_t t = 0; t < traversals; ++t)
+      if (lows[t][u] > lows[t][v] || ranks[t][u] <= ranks[t][v])
+        return false;
+    return true;
+  }
+
+  const PositionGraph &graph;
+  bool cyclic;
+  // The longest path from each node down to a node without dependencies
+  std::vector<uint32_t> heights;
+  std::vector<uint32_t> ranks[traversals];
+  std::vector<uint32_t> lows[traversals];
 };
 
 class GraphMetrics {
@@ -59,6 +245,25 @@ public:
 
 GraphMetrics compute_graph_metrics(const Graph &graph);
 
+// How the dependencies of a detected graph compare with the true ones,
+// counted over the pairs of tests of their transitive closures: exact
+// pairs are in both, missing pairs only in the true graph and spurious
+// pairs only in the detected one.
+class GraphAccuracy {
+public:
+  explicit GraphAccuracy(void);
+
+  uint64_t exact;
+  uint64_t missing;
+  uint64_t spurious;
+};
+
+// Compares the closures of two acyclic graphs over the nodes of reference.
+// The closures are built a block of columns at a time with one bit per
+// pair, so the memory stays bounded however large the graphs are.
+GraphAccuracy compute_graph_accuracy(const Graph &reference,
+                                     const Graph &result);
+
 class GraphGenerator {
 public:
   GraphGenerator(Graph &graph);
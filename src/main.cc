@@ -1,26 +1,87 @@
 #include "algorithms.h"
+#include "checkpoint.h"
 #include "graph.h"
+#include "metrics.h"
+#include "process-oracle.h"
+#include "progress.h"
 #include "test-suite-oracle.h"
 #include "test-suite.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <fcntl.h>
+#include <ctime>
 #include <fstream>
 #include <getopt.h>
 #include <limits>
+#include <map>
 #include <ostream>
 #include <sstream>
 #include <string.h>
-#include <sys/file.h>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 
 int generate_command(int argc, char *argv[]);
 int deps_command(int argc, char *argv[]);
+int merge_command(int argc, char *argv[]);
+int runner_command(int argc, char *argv[]);
+int shard_command(int argc, char *argv[]);
+int replay_command(int argc, char *argv[]);
+int progress_command(int argc, char *argv[]);
 int help_command(int argc, char *argv[]);
 void print_root_help(const char *prog_name);
 void print_deps_help(const char *prog_nmae);
 void print_generate_help(const char *prog_name);
-void record_metrics(const char *metrics_file, DirectDependenciesOracle *oracle,
-                    const Graph &result);
+void print_merge_help(const char *prog_name);
+void print_runner_help(const char *prog_name);
+void print_shard_help(const char *prog_name);
+void print_replay_help(const char *prog_name);
+void print_progress_help(const char *prog_name);
+bool read_experiments(std::vector<std::string> &targets,
+                      std::vector<uint64_t> &costs);
+std::vector<uint32_t>
+split_experiments(const std::vector<std::string> &targets,
+                  const std::vector<uint64_t> &costs, uint32_t shards);
+void print_progress_help(const char *prog_name) {
+  std::cout << "Report how far the experiments read from stdin went."
+            << std::endl
+            << std::endl
+            << "Each input line is an experiment as \"algorithm tests "
+               "target\", like for the"
+            << std::endl
+            << "shard command. An experiment is done once its target exists. "
+               "The time left is"
+            << std::endl
+            << "estimated from the cost of the experiments done since the "
+               "first of them"
+            << std::endl
+            << "finished." << std::endl
+            << std::endl
+            << "Usage: " << std::endl
+            << "  " << prog_name << " progress [flags]" << std::endl
+            << std::endl
+            << "Flags:" << std::endl
+            << "  -s, --shard i/n     Report on the share of the i-th machine "
+               "out of n, from 1."
+            << std::endl
+            << "                      (Default: 1/1)" << std::endl
+            << "  -n, --interval seconds" << std::endl
+            << "                      Report again every given seconds until "
+               "every experiment"
+            << std::endl
+            << "                      is done. (Default: report once)"
+            << std::endl
+            << "  -h, --help          Display this help page." << std::endl
+            << std::endl;
+}
+
+void record_metrics(MetricsSink *sink, const TestSuiteOracle *oracle,
+                    const Algorithm *algo, const Graph &reference,
+                    const Graph &result, uint64_t elapsed_ms);
 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
@@ -34,6 +95,16 @@ int main(int argc, char *argv[]) {
     return generate_command(argc, argv);
   else if (strcmp(argv[1], "deps") == 0)
     return deps_command(argc, argv);
+  else if (strcmp(argv[1], "merge") == 0)
+    return merge_command(argc, argv);
+  else if (strcmp(argv[1], "runner") == 0)
+    return runner_command(argc, argv);
+  else if (strcmp(argv[1], "shard") == 0)
+    return shard_command(argc, argv);
+  else if (strcmp(argv[1], "replay") == 0)
+    return replay_command(argc, argv);
+  else if (strcmp(argv[1], "progress") == 0)
+    return progress_command(argc, argv);
   else if (strcmp(argv[1], "help") == 0)
     return help_command(argc, argv);
 
@@ -120,6 +191,23 @@ int deps_command(int argc, char *argv[]) {
                                     {"algorithm", required_argument, 0, 'a'},
                                     {"output", required_argument, 0, 'o'},
                                     {"metrics", required_argument, 0, 'm'},
+                                    {"metrics-format", required_argument, 0,
+                                     'f'},
+                                    {"checkpoint", required_argument, 0, 'c'},
+                                    {"checkpoint-interval", required_argument,
+                                     0, '0'},
+                                    {"resume", no_argument, 0, 'r'},
+                                    {"max-suite-runs", required_argument, 0,
+                                     '1'},
+                                    {"max-test-runs", required_argument, 0,
+                                     '2'},
+                                    {"time-limit", required_argument, 0, '3'},
+                                    {"runner", required_argument, 0, '4'},
+                                    {"workers", required_argument, 0, '5'},
+                                    {"timeout", required_argument, 0, '6'},
+                                    {"previous", required_argument, 0, '7'},
+                                    {"trace", required_argument, 0, '8'},
+                                    {"progress", required_argument, 0, '9'},
                                     {"help", no_argument, 0, 'h'},
                                     {0, 0, 0, 0}};
   int opt{0}, long_index{0};
@@ -127,9 +215,20 @@ int deps_command(int argc, char *argv[]) {
   char *metric_file{nullptr};
   char *input_file{nullptr};
   char *algorithm{nullptr};
+  char *checkpoint_file{nullptr};
+  uint32_t checkpoint_interval{60};
+  bool resume{false};
+  std::string metrics_format{"csv"};
+  OracleBudget budget;
+  char *runner{nullptr};
+  uint32_t workers{1};
+  std::chrono::milliseconds timeout{0};
+  char *previous_file{nullptr};
+  char *trace_file{nullptr};
+  std::chrono::milliseconds progress_interval{0};
 
-  while ((opt = getopt_long(argc, argv, "i:a:o:m:h", options, &long_index)) !=
-         -1) {
+  while ((opt = getopt_long(argc, argv, "i:a:o:m:f:c:rh", options,
+                            &long_index)) != -1) {
     switch (opt) {
     case 'i':
       input_file = optarg;
@@ -143,6 +242,48 @@ int deps_command(int argc, char *argv[]) {
     case 'm':
       metric_file = optarg;
       break;
+    case 'f':
+      metrics_format = optarg;
+      break;
+    case 'c':
+      checkpoint_file = optarg;
+      break;
+    case '0':
+      checkpoint_interval = strtol(optarg, 0, 10);
+      break;
+    case 'r':
+      resume = true;
+      break;
+    case '1':
+      budget.max_test_suite_runs = strtoull(optarg, 0, 10);
+      break;
+    case '2':
+      budget.max_test_runs = strtoull(optarg, 0, 10);
+      break;
+    case '3':
+      budget.time_limit = std::chrono::milliseconds{
+          (std::chrono::milliseconds::rep)(atof(optarg) * 1000)};
+      break;
+    case '4':
+      runner = optarg;
+      break;
+    case '5':
+      workers = strtol(optarg, 0, 10);
+      break;
+    case '6':
+      timeout = std::chrono::milliseconds{
+          (std::chrono::milliseconds::rep)(atof(optarg) * 1000)};
+      break;
+    case '7':
+      previous_file = optarg;
+      break;
+    case '8':
+      trace_file = optarg;
+      break;
+    case '9':
+      progress_interval = std::chrono::milliseconds{
+          (std::chrono::milliseconds::rep)(atof(optarg) * 1000)};
+      break;
     case 'h':
       print_deps_help(argv[0]);
       return EXIT_SUCCESS;
@@ -152,12 +293,21 @@ int deps_command(int argc, char *argv[]) {
     }
   }
 
-  if (!input_file || !algorithm) {
+  if (!input_file || !algorithm || (resume && !checkpoint_file)) {
     print_deps_help(argv[0]);
 
     return EXIT_FAILURE;
   }
 
+  // The update of a previous graph keeps no checkpoint of its own, so a
+  // resumed run would confirm the previous graph again from scratch
+  if (previous_file && checkpoint_file) {
+    std::cerr << "The --previous and --checkpoint flags cannot be used "
+                 "together."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
   Graph g;
   std::ifstream is{input_file};
   if (!is) {
@@ -168,10 +318,51 @@ int deps_command(int argc, char *argv[]) {
 
   is >> g;
 
-  std::unique_ptr<TestSuiteOracle> oracle{new DirectDependenciesOracle{g}};
+  std::unique_ptr<MetricsSink> sink;
+  if (metric_file)
+    sink = metrics_sink_factory(metrics_format, metric_file);
+
+  // With a runner, the input graph only gives the tests of the suite and
+  // the reference for the metrics
+  std::unique_ptr<TestSuiteOracle> oracle;
+  if (runner)
+    oracle.reset(new ProcessOracle{runner, DirectDependenciesOracle{g}.tests(),
+                                   workers, timeout});
+  else
+    oracle.reset(new DirectDependenciesOracle{g});
+  if (trace_file)
+    oracle.reset(new TracingOracle{std::move(oracle), trace_file});
+  oracle->set_budget(budget);
   std::vector<uint32_t> tests{oracle->tests()};
-  std::unique_ptr<Algorithm> algo{algorithm_factory(algorithm)};
+  std::unique_ptr<Algorithm> algo{algorithm_factory(algorithm, tests.size())};
+  if (previous_file) {
+    Graph previous;
+    std::ifstream prev{previous_file};
+    if (!prev) {
+      std::cerr << "Could not open previous graph file \"" << previous_file
+                << '"' << std::endl;
+      return EXIT_FAILURE;
+    }
+    prev >> previous;
+    algo.reset(new Incremental{previous, std::move(algo)});
+  }
+  std::unique_ptr<Checkpointer> checkpointer;
+  if (checkpoint_file) {
+    checkpointer.reset(
+        new Checkpointer{checkpoint_file, checkpoint_interval, resume});
+    algo->set_checkpointer(checkpointer.get());
+  }
+  Progress progress;
+  std::unique_ptr<Heartbeat> heartbeat;
+  if (progress_interval.count()) {
+    algo->set_progress(&progress);
+    heartbeat.reset(new Heartbeat{progress, *oracle, progress_interval});
+  }
+  auto start = std::chrono::steady_clock::now();
   std::unique_ptr<Graph> result{algo->run(tests, oracle.get())};
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  heartbeat.reset();
 
   if (out_file) {
     std::ofstream out{out_file};
@@ -181,9 +372,413 @@ int deps_command(int argc, char *argv[]) {
     std::cout << *result;
   }
 
-  if (metric_file)
-    record_metrics(metric_file, (DirectDependenciesOracle *)oracle.get(),
-                   *result);
+  if (sink)
+    record_metrics(sink.get(), oracle.get(), algo.get(), g, *result,
+                   elapsed.count());
+
+  // A truncated run can be resumed later with a larger budget
+  if (checkpointer && !algo->is_truncated())
+    checkpointer->remove();
+
+  return EXIT_SUCCESS;
+}
+
+int merge_command(int argc, char *argv[]) {
+  static struct option options[] = {{"metrics", required_argument, 0, 'm'},
+                                    {"help", no_argument, 0, 'h'},
+                                    {0, 0, 0, 0}};
+  int opt{0}, long_index{0};
+  std::vector<const char *> metric_files;
+
+  while ((opt = getopt_long(argc, argv, "m:h", options, &long_index)) != -1) {
+    switch (opt) {
+    case 'm':
+      metric_files.push_back(optarg);
+      break;
+    case 'h':
+      print_merge_help(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      print_merge_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (metric_files.empty()) {
+    print_merge_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int ret{EXIT_SUCCESS};
+  for (const char *metric_file : metric_files)
+    if (!merge_metrics(metric_file))
+      ret = EXIT_FAILURE;
+
+  return ret;
+}
+
+// Reads the experiments of stdin, one "algorithm tests target" per line,
+// with their estimated costs.
+bool read_experiments(std::vector<std::string> &targets,
+                      std::vector<uint64_t> &costs) {
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream iss{line};
+    std::string algorithm, target;
+    uint32_t tests;
+
+    if (line.empty())
+      continue;
+    if (!(iss >> algorithm >> tests >> target)) {
+      std::cerr << "Invalid experiment: " << line << std::endl;
+      return false;
+    }
+    targets.push_back(target);
+    costs.push_back(estimate_cost(algorithm, tests));
+  }
+
+  return true;
+}
+
+// The shard, from 0, that runs each experiment out of the given number.
+std::vector<uint32_t>
+split_experiments(const std::vector<std::string> &targets,
+                  const std::vector<uint64_t> &costs, uint32_t shards) {
+  // Longest processing time first: each experiment, from the most
+  // expensive, goes to the least loaded shard. Breaking the ties on the
+  // targets makes the split the same on every machine.
+  std::vector<std::tuple<uint64_t, std::string, uint32_t>> order;
+  for (uint32_t i = 0; i < targets.size(); ++i)
+    order.emplace_back(~costs[i], targets[i], i);
+  std::sort(order.begin(), order.end());
+
+  std::vector<uint64_t> loads(shards);
+  std::vector<uint32_t> owner(targets.size());
+  for (const auto &experiment : order) {
+    uint32_t i = std::get<2>(experiment);
+    uint32_t least =
+        std::min_element(loads.begin(), loads.end()) - loads.begin();
+    loads[least] += costs[i];
+    owner[i] = least;
+  }
+
+  return owner;
+}
+
+int shard_command(int argc, char *argv[]) {
+  static struct option options[] = {{"shard", required_argument, 0, 's'},
+                                    {"help", no_argument, 0, 'h'},
+                                    {0, 0, 0, 0}};
+  int opt{0}, long_index{0};
+  uint32_t shard{0}, shards{0};
+
+  while ((opt = getopt_long(argc, argv, "s:h", options, &long_index)) != -1) {
+    switch (opt) {
+    case 's':
+      if (sscanf(optarg, "%u/%u", &shard, &shards) != 2)
+        shard = shards = 0;
+      break;
+    case 'h':
+      print_shard_help(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      print_shard_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (shard == 0 || shard > shards) {
+    print_shard_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> targets;
+  std::vector<uint64_t> costs;
+  if (!read_experiments(targets, costs))
+    return EXIT_FAILURE;
+  std::vector<uint32_t> owner{split_experiments(targets, costs, shards)};
+
+  for (uint32_t i = 0; i < targets.size(); ++i)
+    if (owner[i] == shard - 1)
+      std::cout << targets[i] << '\n';
+
+  return EXIT_SUCCESS;
+}
+
+int replay_command(int argc, char *argv[]) {
+  static struct option options[] = {{"trace", required_argument, 0, 't'},
+                                    {"input", required_argument, 0, 'i'},
+                                    {"metrics", required_argument, 0, 'm'},
+                                    {"metrics-format", required_argument, 0,
+                                     'f'},
+                                    {"runner", required_argument, 0, '0'},
+                                    {"workers", required_argument, 0, '1'},
+                                    {"timeout", required_argument, 0, '2'},
+                                    {"help", no_argument, 0, 'h'},
+                                    {0, 0, 0, 0}};
+  int opt{0}, long_index{0};
+  char *trace_file{nullptr};
+  char *input_file{nullptr};
+  char *metric_file{nullptr};
+  std::string metrics_format{"csv"};
+  char *runner{nullptr};
+  uint32_t workers{1};
+  std::chrono::milliseconds timeout{0};
+
+  while ((opt = getopt_long(argc, argv, "t:i:m:f:h", options,
+                            &long_index)) != -1) {
+    switch (opt) {
+    case 't':
+      trace_file = optarg;
+      break;
+    case 'i':
+      input_file = optarg;
+      break;
+    case 'm':
+      metric_file = optarg;
+      break;
+    case 'f':
+      metrics_format = optarg;
+      break;
+    case '0':
+      runner = optarg;
+      break;
+    case '1':
+      workers = strtol(optarg, 0, 10);
+      break;
+    case '2':
+      timeout = std::chrono::milliseconds{
+          (std::chrono::milliseconds::rep)(atof(optarg) * 1000)};
+      break;
+    case 'h':
+      print_replay_help(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      print_replay_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!trace_file || (!input_file && !runner)) {
+    print_replay_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  TraceReader trace{trace_file};
+  std::unique_ptr<TestSuiteOracle> oracle;
+  if (runner) {
+    oracle.reset(new ProcessOracle{runner, trace.tests(), workers, timeout});
+  } else {
+    Graph g;
+    std::ifstream is{input_file};
+    if (!is) {
+      std::cerr << "Could not open input file \"" << input_file << '"'
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    is >> g;
+    oracle.reset(new DirectDependenciesOracle{g});
+    if (oracle->tests() != trace.tests()) {
+      std::cerr << "The trace \"" << trace_file << '"'
+                << " was not recorded on the suite of \"" << input_file << '"'
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The recorded runs are independent, so they fill the window of the
+  // oracle
+  std::map<uint64_t, uint32_t> expected;
+  std::vector<uint32_t> schedule;
+  uint32_t recorded, passed;
+  uint64_t mismatches{0};
+  bool more{true};
+  auto start = std::chrono::steady_clock::now();
+  while (more || !expected.empty()) {
+    if (more && expected.size() < oracle->window()) {
+      if ((more = trace.next(schedule, recorded)))
+        expected[oracle->submit(schedule)] = recorded;
+      continue;
+    }
+
+    auto it = expected.find(oracle->wait(passed));
+    if (passed != it->second)
+      ++mismatches;
+    expected.erase(it);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  MetricsRow row;
+  row.set("n", trace.tests().size());
+  row.set("test_suite_runs", oracle->get_test_suite_runs());
+  row.set("test_runs", oracle->get_test_runs());
+  row.set("mismatches", mismatches);
+  row.set("elapsed_ms", elapsed.count());
+
+  if (metric_file) {
+    metrics_sink_factory(metrics_format, metric_file)->record(row);
+  } else {
+    for (uint32_t i = 0; i < row.columns().size(); ++i)
+      std::cout << (i ? "," : "") << row.columns()[i];
+    std::cout << std::endl;
+    for (uint32_t i = 0; i < row.values().size(); ++i)
+      std::cout << (i ? "," : "") << row.values()[i];
+    std::cout << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int progress_command(int argc, char *argv[]) {
+  static struct option options[] = {{"shard", required_argument, 0, 's'},
+                                    {"interval", required_argument, 0, 'n'},
+                                    {"help", no_argument, 0, 'h'},
+                                    {0, 0, 0, 0}};
+  int opt{0}, long_index{0};
+  uint32_t shard{1}, shards{1};
+  std::chrono::milliseconds interval{0};
+
+  while ((opt = getopt_long(argc, argv, "s:n:h", options, &long_index)) !=
+         -1) {
+    switch (opt) {
+    case 's':
+      if (sscanf(optarg, "%u/%u", &shard, &shards) != 2)
+        shard = shards = 0;
+      break;
+    case 'n':
+      interval = std::chrono::milliseconds{
+          (std::chrono::milliseconds::rep)(atof(optarg) * 1000)};
+      break;
+    case 'h':
+      print_progress_help(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      print_progress_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (shard == 0 || shard > shards) {
+    print_progress_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> targets;
+  std::vector<uint64_t> costs;
+  if (!read_experiments(targets, costs))
+    return EXIT_FAILURE;
+  std::vector<uint32_t> owner{split_experiments(targets, costs, shards)};
+
+  // An experiment is done once its target exists. The cost estimated for
+  // the done experiments over the time since the first of them finished
+  // gives the rate of the sweep, whatever the number of jobs.
+  while (true) {
+    uint32_t total{0}, done{0};
+    uint64_t total_cost{0}, done_cost{0};
+    time_t first{0}, now{time(nullptr)};
+    struct stat st;
+
+    for (uint32_t i = 0; i < targets.size(); ++i) {
+      if (owner[i] != shard - 1)
+        continue;
+      ++total;
+      total_cost += costs[i];
+      if (stat(targets[i].c_str(), &st) != 0)
+        continue;
+      ++done;
+      done_cost += costs[i];
+      if (first == 0 || st.st_mtime < first)
+        first = st.st_mtime;
+    }
+
+    std::cout << done << '/' << total << " experiments done, "
+              << (total_cost ? 100 * done_cost / total_cost : 100)
+              << "% of the estimated cost";
+    if (done == total)
+      std::cout << std::endl;
+    else if (done_cost && now > first)
+      std::cout << ", ETA "
+                << format_duration(std::chrono::seconds{
+                       (total_cost - done_cost) * (now - first) / done_cost})
+                << std::endl;
+    else
+      std::cout << ", ETA unknown" << std::endl;
+
+    if (done == total || interval.count() == 0)
+      break;
+    std::this_thread::sleep_for(interval);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int runner_command(int argc, char *argv[]) {
+  static struct option options[] = {{"input", required_argument, 0, 'i'},
+                                    {"delay", required_argument, 0, 'd'},
+                                    {"help", no_argument, 0, 'h'},
+                                    {0, 0, 0, 0}};
+  int opt{0}, long_index{0};
+  char *input_file{nullptr};
+  std::chrono::milliseconds delay{0};
+
+  while ((opt = getopt_long(argc, argv, "i:d:h", options, &long_index)) !=
+         -1) {
+    switch (opt) {
+    case 'i':
+      input_file = optarg;
+      break;
+    case 'd':
+      delay = std::chrono::milliseconds{strtol(optarg, 0, 10)};
+      break;
+    case 'h':
+      print_runner_help(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      print_runner_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!input_file) {
+    print_runner_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Graph g;
+  std::ifstream is{input_file};
+  if (!is) {
+    std::cerr << "Could not open input file \"" << input_file << '"'
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  is >> g;
+
+  DirectDependenciesOracle oracle{g};
+  std::vector<uint32_t> nodes{oracle.tests()};
+  std::unordered_set<uint32_t> known{nodes.begin(), nodes.end()};
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream iss{line};
+    std::vector<uint32_t> schedule;
+    uint32_t test;
+
+    while (iss >> test) {
+      if (known.find(test) == known.end()) {
+        std::cerr << "Unknown test " << test << " in schedule." << std::endl;
+        return EXIT_FAILURE;
+      }
+      schedule.push_back(test);
+    }
+
+    std::vector<bool> results{oracle.run_tests(schedule)};
+    if (delay.count())
+      std::this_thread::sleep_for(delay);
+    for (const bool passed : results)
+      std::cout << (passed ? '1' : '0');
+    std::cout << std::endl;
+  }
 
   return EXIT_SUCCESS;
 }
@@ -199,6 +794,16 @@ int help_command(int argc, char *argv[]) {
     print_generate_help(argv[0]);
   else if (strcmp(argv[2], "deps") == 0)
     print_deps_help(argv[0]);
+  else if (strcmp(argv[2], "merge") == 0)
+    print_merge_help(argv[0]);
+  else if (strcmp(argv[2], "runner") == 0)
+    print_runner_help(argv[0]);
+  else if (strcmp(argv[2], "shard") == 0)
+    print_shard_help(argv[0]);
+  else if (strcmp(argv[2], "replay") == 0)
+    print_replay_help(argv[0]);
+  else if (strcmp(argv[2], "progress") == 0)
+    print_progress_help(argv[0]);
   else {
     print_root_help(argv[0]);
     return EXIT_FAILURE;
@@ -220,6 +825,17 @@ void print_root_help(const char *prog_name) {
             << "  generate  Generates a synthetic test suite." << std::endl
             << "  deps      Finds dependencies between tests of a test suite."
             << std::endl
+            << "  merge     Merges sharded metrics into their CSV file."
+            << std::endl
+            << "  runner    Runs schedules against a test suite, as a test "
+               "runner."
+            << std::endl
+            << "  shard     Splits experiments among several machines."
+            << std::endl
+            << "  replay    Runs the schedules of a trace against an oracle."
+            << std::endl
+            << "  progress  Reports how far a sweep of experiments went."
+            << std::endl
             << std::endl
             << "Use \"" << prog_name << " help [command]\" for more information"
             << " about a command." << std::endl;
@@ -241,13 +857,75 @@ void print_deps_help(const char *prog_name) {
          "(Required)"
       << std::endl
       << "                        The possible values are: pradet, pfast, "
-         "mem-fast."
+         "mem-fast,"
+      << std::endl
+      << "                        pradet-batch, bisect, pfast-dd, auto."
       << std::endl
       << "  -o, --output file     The file to store dependency detection "
          "results. (Default: stdout)"
       << std::endl
       << "  -m, --metrics file    The file to store metrics about the run."
       << std::endl
+      << "  -f, --metrics-format fmt" << std::endl
+      << "                        How to store metrics. (Default: csv)"
+      << std::endl
+      << "                        The possible values are: csv, shard, "
+         "shard-bin."
+      << std::endl
+      << "  -c, --checkpoint file The file to periodically save the state "
+         "of the run into."
+      << std::endl
+      << "  --checkpoint-interval n"
+      << std::endl
+      << "                        The seconds between two checkpoints. "
+         "(Default: 60)"
+      << std::endl
+      << "  -r, --resume          Resume the run from the checkpoint file, "
+         "if it exists."
+      << std::endl
+      << "  --max-suite-runs n    Stop after running n test schedules."
+      << std::endl
+      << "  --max-test-runs n     Stop after running n tests." << std::endl
+      << "  --time-limit secs     Stop after running for the given seconds."
+      << std::endl
+      << "                        A stopped run outputs the dependencies it "
+         "could not disprove yet."
+      << std::endl
+      << "  --runner command      Run the schedules with the given test "
+         "runner command instead"
+      << std::endl
+      << "                        of the input file, which then only lists "
+         "the tests."
+      << std::endl
+      << "                        See \"help runner\" for its protocol."
+      << std::endl
+      << "  --workers n           The number of runner processes to keep, "
+         "which is also how"
+      << std::endl
+      << "                        many schedules can run at once. "
+         "(Default: 1)"
+      << std::endl
+      << "  --timeout secs        Count a schedule that takes longer as "
+         "failing. (Default: none)"
+      << std::endl
+      << "  --previous file       Update the graph found by an earlier run, "
+         "searching again only"
+      << std::endl
+      << "                        the tests it no longer holds for. The "
+         "algorithm searches the"
+      << std::endl
+      << "                        whole suite when most tests changed. "
+         "Cannot be used with"
+      << std::endl
+      << "                        --checkpoint." << std::endl
+      << "  --trace file          Record every schedule run and its results "
+         "into the file,"
+      << std::endl
+      << "                        for the replay command." << std::endl
+      << "  --progress seconds    Print the progress of the run to stderr "
+         "every given"
+      << std::endl
+      << "                        seconds." << std::endl
       << "  -h, --help            Display this help page." << std::endl
       << std::endl;
 }
@@ -285,34 +963,151 @@ void print_generate_help(const char *prog_name) {
             << std::endl;
 }
 
-void record_metrics(const char *metrics_file, DirectDependenciesOracle *oracle,
-                    const Graph &result) {
-  GraphMetrics optimal = compute_graph_metrics(oracle->get_graph());
-  GraphMetrics computed = compute_graph_metrics(oracle->get_graph());
+void print_merge_help(const char *prog_name) {
+  std::cout << "Merge the metrics shards written by the shard and shard-bin"
+            << std::endl
+            << "metrics formats into their CSV file." << std::endl
+            << std::endl
+            << "Usage: " << std::endl
+            << "  " << prog_name << " merge [flags]" << std::endl
+            << std::endl
+            << "Flags:" << std::endl
+            << "  -m, --metrics file  The CSV file to merge the shards into. "
+               "Can be repeated. (Required)"
+            << std::endl
+            << "  -h, --help          Display this help page." << std::endl
+            << std::endl;
+}
 
-  int fd = open(metrics_file, O_WRONLY | O_CREAT, 0644);
-  if (fd < 0 || flock(fd, LOCK_EX) != 0) {
-    std::cerr << "Failed to write into stats file " << metrics_file << ": "
-              << strerror(errno) << std::endl;
-    return;
-  }
-  std::ostringstream oss;
+void print_shard_help(const char *prog_name) {
+  std::cout << "Print the experiments read from stdin that one machine out "
+               "of several runs."
+            << std::endl
+            << std::endl
+            << "Each input line is an experiment as \"algorithm tests "
+               "target\". The experiments"
+            << std::endl
+            << "are split by their estimated cost, so that the machines "
+               "finish together, and"
+            << std::endl
+            << "the same way on every machine given the same experiments. "
+               "The targets of the"
+            << std::endl
+            << "given shard are printed in their input order." << std::endl
+            << std::endl
+            << "Usage: " << std::endl
+            << "  " << prog_name << " shard [flags]" << std::endl
+            << std::endl
+            << "Flags:" << std::endl
+            << "  -s, --shard i/n     Print the share of the i-th machine out "
+               "of n, from 1. (Required)"
+            << std::endl
+            << "  -h, --help          Display this help page." << std::endl
+            << std::endl;
+}
 
-  if (lseek(fd, 0, SEEK_END) == 0)
-    oss << "n,test_suite_runs,test_runs,"
-           "optimal_longest_schedule,longest_schedule,"
-           "optimal_total_cost,total_cost"
-        << std::endl;
+void print_replay_help(const char *prog_name) {
+  std::cout
+      << "Run the schedules recorded by \"deps --trace\" against a test "
+         "suite or a test"
+      << std::endl
+      << "runner, without running the algorithm that chose them, and "
+         "report the runs,"
+      << std::endl
+      << "the time taken and the schedules whose results differ from the "
+         "recorded ones."
+      << std::endl
+      << std::endl
+      << "Usage: " << std::endl
+      << "  " << prog_name << " replay [flags]" << std::endl
+      << std::endl
+      << "Flags:" << std::endl
+      << "  -t, --trace file      The trace to replay. (Required)"
+      << std::endl
+      << "  -i, --input file      The file containing the synthetic test "
+         "suite to run against."
+      << std::endl
+      << "                        (Required without --runner)" << std::endl
+      << "  -m, --metrics file    The file to store the metrics into. "
+         "(Default: stdout)"
+      << std::endl
+      << "  -f, --metrics-format fmt" << std::endl
+      << "                        How to store metrics. (Default: csv)"
+      << std::endl
+      << "                        The possible values are: csv, shard, "
+         "shard-bin."
+      << std::endl
+      << "  --runner command      Run the schedules with the given test "
+         "runner command."
+      << std::endl
+      << "  --workers n           The number of runner processes to keep. "
+         "(Default: 1)"
+      << std::endl
+      << "  --timeout secs        Count a schedule that takes longer as "
+         "failing. (Default: none)"
+      << std::endl
+      << "  -h, --help            Display this help page." << std::endl
+      << std::endl;
+}
+
+void print_runner_help(const char *prog_name) {
+  std::cout << "Run the schedules read from stdin against a synthetic test "
+               "suite, as the"
+            << std::endl
+            << "test runner of \"deps --runner\"." << std::endl
+            << std::endl
+            << "Each input line is a schedule of test ids separated by "
+               "spaces. Each output"
+            << std::endl
+            << "line has a 1 for every test of the schedule that passed and "
+               "a 0 for every"
+            << std::endl
+            << "test that failed." << std::endl
+            << std::endl
+            << "Usage: " << std::endl
+            << "  " << prog_name << " runner [flags]" << std::endl
+            << std::endl
+            << "Flags:" << std::endl
+            << "  -i, --input file  The file containing the synthetic test "
+               "suite. (Required)"
+            << std::endl
+            << "  -d, --delay ms    The milliseconds to wait before answering "
+               "each schedule."
+            << std::endl
+            << "  -h, --help        Display this help page." << std::endl
+            << std::endl;
+}
 
-  oss << oracle->get_graph().size() << ',' << oracle->get_test_suite_runs()
-      << ',' << oracle->get_test_runs() << ',' << optimal.longest_schedule
-      << ',' << computed.longest_schedule << ',' << optimal.total_cost << ','
-      << computed.total_cost << std::endl;
+void record_metrics(MetricsSink *sink, const TestSuiteOracle *oracle,
+                    const Algorithm *algo, const Graph &reference,
+                    const Graph &result, uint64_t elapsed_ms) {
+  GraphMetrics optimal = compute_graph_metrics(reference);
+  GraphMetrics computed = compute_graph_metrics(result);
+  GraphAccuracy accuracy = compute_graph_accuracy(reference, result);
+  MetricsRow row;
 
-  if (write(fd, oss.str().c_str(), oss.str().size()) == -1)
-    std::cerr << "Failed to write into stats file " << metrics_file << ": "
-              << strerror(errno) << std::endl;
+  row.set("n", reference.size());
+  row.set("test_suite_runs", oracle->get_test_suite_runs());
+  row.set("test_runs", oracle->get_test_runs());
+  row.set("optimal_longest_schedule", optimal.longest_schedule);
+  row.set("longest_schedule", computed.longest_schedule);
+  row.set("optimal_total_cost", optimal.total_cost);
+  row.set("total_cost", computed.total_cost);
+  row.set("truncated", algo->is_truncated());
+  row.set("elapsed_ms", elapsed_ms);
+  row.set("exact_dependencies", accuracy.exact);
+  row.set("missing_dependencies", accuracy.missing);
+  row.set("spurious_dependencies", accuracy.spurious);
+  row.set("longest_schedule_delta",
+          (int64_t)computed.longest_schedule - optimal.longest_schedule);
+  row.set("total_cost_delta",
+          (int64_t)computed.total_cost - optimal.total_cost);
+  // Every run writes the columns of auto, so that the rows of all the
+  // algorithms share one header
+  for (const char *column : {"auto_algorithm", "probe_suite_runs",
+                              "probe_test_runs", "predicted_suite_runs"})
+    row.set(column, metric_default(column));
+  algo->add_metrics(row);
 
-  flock(fd, LOCK_UN);
-  close(fd);
+  sink->record(row);
 }
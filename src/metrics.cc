@@ -0,0 +1,444 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char binary_magic[] = {'S', 'T', 'S', 'M'};
+static const uint32_t binary_version = 1;
+
+void MetricsRow::set(const std::string &column, int64_t value) {
+  auto it = std::find(names.begin(), names.end(), column);
+
+  if (it != names.end()) {
+    data[it - names.begin()] = value;
+    return;
+  }
+
+  names.push_back(column);
+  data.push_back(value);
+}
+
+static std::string csv_header(const std::vector<std::string> &columns) {
+  std::string header;
+
+  for (const auto &column : columns) {
+    if (!header.empty())
+      header += ',';
+    header += column;
+  }
+
+  return header;
+}
+
+static std::string csv_line(const std::vector<int64_t> &values) {
+  std::ostringstream oss;
+
+  for (uint32_t i = 0; i < values.size(); ++i)
+    oss << (i ? "," : "") << values[i];
+
+  return oss.str();
+}
+
+static void put_u32(std::string &buf, uint32_t v) {
+  for (uint32_t i = 0; i < 4; ++i)
+    buf.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+static void put_i64(std::string &buf, int64_t v) {
+  for (uint32_t i = 0; i < 8; ++i)
+    buf.push_back((char)(((uint64_t)v >> (8 * i)) & 0xff));
+}
+
+static bool get_u32(const std::string &buf, size_t &pos, uint32_t &v) {
+  if (pos + 4 > buf.size())
+    return false;
+
+  v = 0;
+  for (uint32_t i = 0; i < 4; ++i)
+    v |= (uint32_t)(uint8_t)buf[pos++] << (8 * i);
+
+  return true;
+}
+
+static bool get_i64(const std::string &buf, size_t &pos, int64_t &v) {
+  if (pos + 8 > buf.size())
+    return false;
+
+  uint64_t u{0};
+  for (uint32_t i = 0; i < 8; ++i)
+    u |= (uint64_t)(uint8_t)buf[pos++] << (8 * i);
+  v = (int64_t)u;
+
+  return true;
+}
+
+static bool write_all(int fd, const std::string &buf) {
+  size_t written{0};
+
+  while (written < buf.size()) {
+    ssize_t r = write(fd, buf.data() + written, buf.size() - written);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    written += r;
+  }
+
+  return true;
+}
+
+// The columns are only ever appended to the metrics, so a header holds the
+// rows of an older one when it starts with its columns. Those rows take
+// the default value of the new columns.
+static bool extends(const std::string &header, const std::string &older) {
+  return header.size() > older.size() &&
+         header.compare(0, older.size(), older) == 0 &&
+         header[older.size()] == ',';
+}
+
+int64_t metric_default(const std::string &column) {
+  static const std::map<std::string, int64_t> defaults{
+      {"truncated", 0}, {"probe_suite_runs", 0}, {"probe_test_runs", 0}};
+  auto it = defaults.find(column);
+
+  return it == defaults.end() ? -1 : it->second;
+}
+
+// The cells appended to a row of the older header, with the default values
+// of the columns header adds to it. A delta is still derived from the row,
+// from its value and the optimal one.
+static std::string padding(const std::string &header, const std::string &older,
+                           const std::string &line) {
+  if (header.size() <= older.size())
+    return "";
+
+  std::istringstream older_columns{older}, cells{line},
+      columns{header.substr(older.size() + 1)};
+  std::map<std::string, int64_t> row;
+  std::string column, cell, pad;
+
+  while (std::getline(older_columns, column, ',') &&
+         std::getline(cells, cell, ','))
+    row[column] = strtoll(cell.c_str(), nullptr, 10);
+  while (std::getline(columns, column, ',')) {
+    int64_t value = metric_default(column);
+    size_t delta = column.rfind("_delta");
+
+    if (delta != std::string::npos && delta + 6 == column.size()) {
+      std::string measure{column.substr(0, delta)};
+      auto it = row.find(measure), optimal = row.find("optimal_" + measure);
+      if (it != row.end() && optimal != row.end())
+        value = it->second - optimal->second;
+    }
+    pad += ',' + std::to_string(value);
+  }
+
+  return pad;
+}
+
+// Rewrites the file open at fd, whose rows were written under the older
+// header it starts with, under the given header.
+static bool upgrade_file(int fd, const std::string &file,
+                         const std::string &header) {
+  std::ifstream is{file};
+  std::string older, line;
+  std::getline(is, older);
+  std::string buf{header + '\n'};
+
+  while (std::getline(is, line))
+    if (!line.empty())
+      buf += line + padding(header, older, line) + '\n';
+  if (is.bad())
+    return false;
+
+  return ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0 &&
+         write_all(fd, buf);
+}
+
+CsvMetricsSink::CsvMetricsSink(const std::string &file) : file{file} {}
+
+bool CsvMetricsSink::record(const MetricsRow &row) {
+  int fd = open(file.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+    std::cerr << "Failed to write into stats file " << file << ": "
+              << strerror(errno) << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  std::string header{csv_header(row.columns())}, file_header, buf;
+  std::ifstream existing{file};
+  std::getline(existing, file_header);
+  existing.close();
+
+  bool ok{true};
+  if (file_header.empty()) {
+    file_header = header;
+    buf += header + '\n';
+  } else if (extends(header, file_header)) {
+    ok = upgrade_file(fd, file, header);
+    file_header = header;
+  } else if (header != file_header && !extends(file_header, header)) {
+    std::cerr << "The metrics do not match the columns of stats file "
+              << file << std::endl;
+    flock(fd, LOCK_UN);
+    close(fd);
+    return false;
+  }
+  std::string line{csv_line(row.values())};
+  buf += line + padding(file_header, header, line) + '\n';
+
+  ok = ok && lseek(fd, 0, SEEK_END) >= 0 && write_all(fd, buf);
+  if (!ok)
+    std::cerr << "Failed to write into stats file " << file << ": "
+              << strerror(errno) << std::endl;
+
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  return ok;
+}
+
+ShardMetricsSink::ShardMetricsSink(const std::string &file, bool binary)
+    : file{file}, name{}, binary{binary} {
+  char host[256]{};
+  gethostname(host, sizeof(host) - 1);
+  std::ostringstream oss;
+  oss << host << '-' << getpid() << '-'
+      << std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+             .count()
+      << (binary ? ".bin" : ".csv");
+  name = oss.str();
+}
+
+bool ShardMetricsSink::record(const MetricsRow &row) {
+  std::string dir{file + ".d"};
+
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "Failed to create stats shard directory " << dir << ": "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  std::ostringstream path;
+  path << dir << '/' << name;
+
+  // The shard is private to this process, so no lock is needed: the
+  // header is written only when the shard is still empty, and every row
+  // goes out in a single append.
+  int fd = open(path.str().c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::cerr << "Failed to write into stats shard " << path.str() << ": "
+              << strerror(errno) << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  std::string buf;
+
+  if (binary) {
+    if (st.st_size == 0) {
+      buf.append(binary_magic, sizeof(binary_magic));
+      put_u32(buf, binary_version);
+      put_u32(buf, row.columns().size());
+      for (const auto &column : row.columns()) {
+        put_u32(buf, column.size());
+        buf += column;
+      }
+    }
+    for (const int64_t v : row.values())
+      put_i64(buf, v);
+  } else {
+    if (st.st_size == 0)
+      buf += csv_header(row.columns()) + '\n';
+    buf += csv_line(row.values()) + '\n';
+  }
+
+  bool ok = write_all(fd, buf);
+  if (!ok)
+    std::cerr << "Failed to write into stats shard " << path.str() << ": "
+              << strerror(errno) << std::endl;
+  close(fd);
+
+  return ok;
+}
+
+std::unique_ptr<MetricsSink> metrics_sink_factory(const std::string &format,
+                                                  const std::string &file) {
+  if (format == "csv")
+    return std::unique_ptr<MetricsSink>{new CsvMetricsSink{file}};
+  else if (format == "shard")
+    return std::unique_ptr<MetricsSink>{new ShardMetricsSink{file, false}};
+  else if (format == "shard-bin")
+    return std::unique_ptr<MetricsSink>{new ShardMetricsSink{file, true}};
+  std::cerr << '"' << format << '"' << " is not a valid metrics format."
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+// Reads a shard into its CSV header and the CSV lines of its rows.
+static bool read_shard(const std::string &path, std::string &header,
+                       std::vector<std::string> &lines) {
+  std::ifstream is{path, std::ios::binary};
+  if (!is)
+    return false;
+  std::string buf{std::istreambuf_iterator<char>{is},
+                  std::istreambuf_iterator<char>{}};
+
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+    std::istringstream iss{buf};
+    std::string line;
+
+    if (!std::getline(iss, header))
+      return false;
+    while (std::getline(iss, line))
+      if (!line.empty())
+        lines.push_back(line);
+    return true;
+  }
+
+  size_t pos{sizeof(binary_magic)};
+  uint32_t version, ncols;
+  if (buf.compare(0, sizeof(binary_magic), binary_magic,
+                  sizeof(binary_magic)) != 0 ||
+      !get_u32(buf, pos, version) || version != binary_version ||
+      !get_u32(buf, pos, ncols))
+    return false;
+
+  std::vector<std::string> columns;
+  for (uint32_t i = 0; i < ncols; ++i) {
+    uint32_t len;
+    if (!get_u32(buf, pos, len) || pos + len > buf.size())
+      return false;
+    columns.push_back(buf.substr(pos, len));
+    pos += len;
+  }
+  header = csv_header(columns);
+
+  while (pos < buf.size()) {
+    std::vector<int64_t> values(ncols);
+    for (int64_t &v : values)
+      if (!get_i64(buf, pos, v))
+        return false;
+    lines.push_back(csv_line(values));
+  }
+
+  return true;
+}
+
+bool merge_metrics(const std::string &file) {
+  std::string dir{file + ".d"};
+  std::vector<std::string> shards;
+
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    if (errno == ENOENT)
+      return true;
+    std::cerr << "Failed to open stats shard directory " << dir << ": "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  for (struct dirent *entry = readdir(d); entry; entry = readdir(d)) {
+    std::string name{entry->d_name};
+    if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".csv") == 0 ||
+                            name.compare(name.size() - 4, 4, ".bin") == 0))
+      shards.push_back(name);
+  }
+  closedir(d);
+  std::sort(shards.begin(), shards.end());
+
+  int fd = open(file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+    std::cerr << "Failed to write into stats file " << file << ": "
+              << strerror(errno) << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+
+  std::string header;
+  std::ifstream existing{file};
+  std::getline(existing, header);
+  existing.close();
+
+  std::set<std::string> merged;
+  std::ifstream merged_in{file + ".merged"};
+  for (std::string name; std::getline(merged_in, name);)
+    merged.insert(name);
+  merged_in.close();
+  std::ofstream merged_out{file + ".merged", std::ios::app};
+
+  bool ok{true};
+  for (const auto &name : shards) {
+    std::string shard{dir + '/' + name};
+    std::string shard_header;
+    std::vector<std::string> lines;
+
+    if (merged.find(name) != merged.end()) {
+      unlink(shard.c_str());
+      continue;
+    }
+
+    if (!read_shard(shard, shard_header, lines)) {
+      std::cerr << "Malformed stats shard " << shard << std::endl;
+      ok = false;
+      continue;
+    }
+
+    std::string buf;
+    if (header.empty()) {
+      header = shard_header;
+      buf += header + '\n';
+    } else if (extends(shard_header, header)) {
+      if (!upgrade_file(fd, file, shard_header)) {
+        std::cerr << "Failed to write into stats file " << file << ": "
+                  << strerror(errno) << std::endl;
+        ok = false;
+        break;
+      }
+      header = shard_header;
+    } else if (header != shard_header && !extends(header, shard_header)) {
+      std::cerr << "Stats shard " << shard << " does not match the columns of "
+                << file << std::endl;
+      ok = false;
+      continue;
+    }
+    for (const auto &line : lines)
+      buf += line + padding(header, shard_header, line) + '\n';
+
+    if (lseek(fd, 0, SEEK_END) < 0 || !write_all(fd, buf)) {
+      std::cerr << "Failed to write into stats file " << file << ": "
+                << strerror(errno) << std::endl;
+      ok = false;
+      break;
+    }
+    if (!(merged_out << name << std::endl)) {
+      std::cerr << "Failed to write into " << file << ".merged" << std::endl;
+      ok = false;
+      break;
+    }
+    unlink(shard.c_str());
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  rmdir(dir.c_str());
+
+  return ok;
+}
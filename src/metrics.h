@@ -0,0 +1,71 @@
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MetricsRow {
+public:
+  void set(const std::string &column, int64_t value);
+
+  inline const std::vector<std::string> &columns(void) const {
+    return names;
+  }
+  inline const std::vector<int64_t> &values(void) const { return data; }
+
+private:
+  std::vector<std::string> names;
+  std::vector<int64_t> data;
+};
+
+class MetricsSink {
+public:
+  virtual ~MetricsSink(void) {}
+  virtual bool record(const MetricsRow &row) = 0;
+};
+
+// Appends rows to a single CSV file shared by every process, serializing
+// the writers with an exclusive flock.
+class CsvMetricsSink : public MetricsSink {
+public:
+  CsvMetricsSink(const std::string &file);
+
+  bool record(const MetricsRow &row) override;
+
+private:
+  std::string file;
+};
+
+// Writes rows into a shard file owned by the calling process, inside the
+// "<file>.d" directory, so that concurrent runs never contend on a lock.
+// The shards are named after the host, the process and its start time, so
+// that the shards of several machines can be copied together. They are
+// combined into "<file>" by merge_metrics.
+class ShardMetricsSink : public MetricsSink {
+public:
+  ShardMetricsSink(const std::string &file, bool binary);
+
+  bool record(const MetricsRow &row) override;
+
+private:
+  std::string file;
+  std::string name;
+  bool binary;
+};
+
+// The value of a column in the rows written before it existed, so that
+// every cell of a stats file is a number: 0 for the counts an older run
+// never had, like the probes of auto, and -1 for the values it did not
+// measure.
+int64_t metric_default(const std::string &column);
+
+std::unique_ptr<MetricsSink> metrics_sink_factory(const std::string &format,
+                                                  const std::string &file);
+// Appends the rows of the shards into "<file>" and removes the shards. The
+// names of the merged shards are kept in "<file>.merged", so that a shard
+// copied again after its merge is dropped instead of duplicating its rows.
+bool merge_metrics(const std::string &file);
+
+#endif
@@ -0,0 +1,317 @@
+#include "process-oracle.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+RunnerWorker::RunnerWorker(const std::string &command)
+    : command{command}, pid{-1}, in{-1}, out{-1}, buffer{} {}
+
+RunnerWorker::~RunnerWorker(void) { stop(); }
+
+bool RunnerWorker::start(void) {
+  int to_child[2], from_child[2];
+
+  if (pipe2(to_child, O_CLOEXEC) != 0)
+    return false;
+  if (pipe2(from_child, O_CLOEXEC) != 0) {
+    close(to_child[0]);
+    close(to_child[1]);
+    return false;
+  }
+
+  pid = fork();
+  if (pid < 0) {
+    close(to_child[0]);
+    close(to_child[1]);
+    close(from_child[0]);
+    close(from_child[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    // dup2 clears the close-on-exec flag of the copies only
+    if (dup2(to_child[0], STDIN_FILENO) < 0 ||
+        dup2(from_child[1], STDOUT_FILENO) < 0)
+      _exit(127);
+    execl("/bin/sh", "sh", "-c", command.c_str(), (char *)nullptr);
+    _exit(127);
+  }
+
+  close(to_child[0]);
+  close(from_child[1]);
+  in = to_child[1];
+  out = from_child[0];
+  buffer.clear();
+
+  return true;
+}
+
+void RunnerWorker::stop(void) {
+  if (pid < 0)
+    return;
+
+  // Closing its input lets the runner exit on its own
+  close(in);
+  close(out);
+  kill(pid, SIGTERM);
+  while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+    ;
+  pid = -1;
+  in = out = -1;
+}
+
+bool RunnerWorker::send(const std::string &line) {
+  size_t written{0};
+
+  while (written < line.size()) {
+    ssize_t r = write(in, line.data() + written, line.size() - written);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    written += r;
+  }
+
+  return true;
+}
+
+bool RunnerWorker::fill(void) {
+  char chunk[4096];
+  ssize_t r;
+
+  while ((r = read(out, chunk, sizeof(chunk))) < 0 && errno == EINTR)
+    ;
+  if (r <= 0)
+    return false;
+  buffer.append(chunk, r);
+
+  return true;
+}
+
+bool RunnerWorker::next_line(std::string &line) {
+  size_t end = buffer.find('\n');
+
+  if (end == std::string::npos)
+    return false;
+  line = buffer.substr(0, end);
+  buffer.erase(0, end + 1);
+
+  return true;
+}
+
+ProcessOracle::ProcessOracle(const std::string &command,
+                             const std::vector<uint32_t> &tests,
+                             uint32_t workers,
+                             std::chrono::milliseconds timeout)
+    : command{command}, suite{tests}, workers{}, runs{}, timeout{timeout} {
+  // A runner that exits early must not kill the whole run
+  signal(SIGPIPE, SIG_IGN);
+
+  for (uint32_t i = 0; i < std::max<uint32_t>(workers, 1); ++i) {
+    this->workers.emplace_back(new RunnerWorker{command});
+    if (!this->workers.back()->start()) {
+      std::cerr << "Failed to start the test runner \"" << command
+                << "\": " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  runs.resize(this->workers.size());
+}
+
+ProcessOracle::~ProcessOracle(void) {}
+
+std::vector<uint32_t> ProcessOracle::tests(void) const { return suite; }
+
+uint32_t ProcessOracle::window(void) const { return workers.size(); }
+
+std::vector<bool>
+ProcessOracle::run_tests(const std::vector<uint32_t> &tests) {
+  std::vector<bool> results(tests.size(), false);
+  uint32_t passed = wait_for(submit(tests));
+
+  std::fill(results.begin(), results.begin() + passed, true);
+
+  return results;
+}
+
+uint32_t ProcessOracle::run_schedule(const ScheduleView &schedule) {
+  return wait_for(submit(schedule));
+}
+
+uint64_t ProcessOracle::submit(const std::vector<uint32_t> &tests) {
+  return start_run(tests.begin(), tests.end(), tests.size());
+}
+
+uint64_t ProcessOracle::submit(const ScheduleView &schedule) {
+  return start_run(schedule.begin(), schedule.end(), schedule.size());
+}
+
+void ProcessOracle::await(void) {
+  while (finished.empty())
+    poll_workers();
+}
+
+template <class It>
+uint64_t ProcessOracle::start_run(It first, It last, uint32_t size) {
+  uint64_t ticket{next_ticket++};
+
+  ++test_suite_runs;
+  if (size == 0) {
+    finished.push_back(Finished{ticket, 0, 0});
+    return ticket;
+  }
+
+  auto idle = std::find(runs.begin(), runs.end(), nullptr);
+  while (idle == runs.end()) {
+    poll_workers();
+    idle = std::find(runs.begin(), runs.end(), nullptr);
+  }
+
+  std::ostringstream oss;
+  for (It it = first; it != last; ++it)
+    oss << (it != first ? " " : "") << *it;
+  oss << '\n';
+
+  uint32_t worker = idle - runs.begin();
+  idle->reset(new Run{ticket, oss.str(), size,
+                      std::chrono::steady_clock::now() + timeout, false});
+  // A worker that cannot take the schedule is handled like one dying
+  // while running it
+  if (!workers[worker]->send((*idle)->request))
+    restart(worker);
+
+  return ticket;
+}
+
+// Waits for the run with the given ticket, keeping the runs submitted
+// before for their own wait.
+uint32_t ProcessOracle::wait_for(uint64_t ticket) {
+  while (true) {
+    for (uint32_t i = 0; i < finished.size(); ++i)
+      if (finished[i].ticket == ticket) {
+        uint32_t passed = finished[i].passed;
+        finished.erase(finished.begin() + i);
+        return passed;
+      }
+
+    poll_workers();
+  }
+}
+
+// Waits until some busy worker answers, dies or times out, and handles it.
+void ProcessOracle::poll_workers(void) {
+  std::vector<struct pollfd> fds;
+  std::vector<uint32_t> busy;
+  auto now = std::chrono::steady_clock::now();
+  int wait_ms{-1};
+
+  for (uint32_t i = 0; i < runs.size(); ++i) {
+    if (!runs[i])
+      continue;
+    fds.push_back(pollfd{workers[i]->output(), POLLIN, 0});
+    busy.push_back(i);
+    if (timeout.count()) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      runs[i]->deadline - now)
+                      .count();
+      left = std::max<int64_t>(left, 0);
+      if (wait_ms < 0 || left < wait_ms)
+        wait_ms = left;
+    }
+  }
+
+  int ready = poll(fds.data(), fds.size(), wait_ms);
+  if (ready < 0 && errno != EINTR) {
+    std::cerr << "Failed to wait for the test runner \"" << command
+              << "\": " << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  now = std::chrono::steady_clock::now();
+  for (uint32_t k = 0; k < fds.size(); ++k) {
+    uint32_t i = busy[k];
+    std::string line;
+
+    if (ready > 0 && fds[k].revents) {
+      if (!workers[i]->fill())
+        restart(i);
+      else if (workers[i]->next_line(line))
+        finish(i, line);
+    } else if (timeout.count() && now >= runs[i]->deadline) {
+      time_out(i);
+    }
+  }
+}
+
+// Restarts a worker that died and gives it its schedule again, once.
+void ProcessOracle::restart(uint32_t worker) {
+  Run &run = *runs[worker];
+
+  workers[worker]->stop();
+  if (run.retried || !workers[worker]->start() ||
+      !workers[worker]->send(run.request)) {
+    std::cerr << "The test runner \"" << command << "\" died." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  run.retried = true;
+  run.deadline = std::chrono::steady_clock::now() + timeout;
+}
+
+void ProcessOracle::finish(uint32_t worker, const std::string &line) {
+  std::unique_ptr<Run> run{std::move(runs[worker])};
+  std::vector<bool> results;
+
+  if (!parse_results(line, run->size, results)) {
+    std::cerr << "Invalid answer from the test runner \"" << command
+              << "\" for a schedule of " << run->size << " tests: " << line
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // The algorithms expect the answers of DirectDependenciesOracle, where
+  // no test passes after the first failure
+  uint32_t passed =
+      std::find(results.begin(), results.end(), false) - results.begin();
+  if (passed == results.size())
+    test_runs += results.size();
+  else
+    test_runs += passed + 1;
+
+  finished.push_back(Finished{run->ticket, passed, run->size});
+}
+
+void ProcessOracle::time_out(uint32_t worker) {
+  std::unique_ptr<Run> run{std::move(runs[worker])};
+
+  workers[worker]->stop();
+  if (!workers[worker]->start()) {
+    std::cerr << "Failed to restart the test runner \"" << command
+              << "\": " << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  test_runs += 1;
+  finished.push_back(Finished{run->ticket, 0, run->size});
+}
+
+bool ProcessOracle::parse_results(const std::string &line, uint32_t n,
+                                  std::vector<bool> &results) const {
+  results.clear();
+  for (const char c : line) {
+    if (c == '1' || c == '0')
+      results.push_back(c == '1');
+    else if (c != ' ' && c != '\t' && c != '\r')
+      return false;
+  }
+
+  return results.size() == n;
+}
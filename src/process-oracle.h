@@ -0,0 +1,94 @@
+#ifndef PROCESS_ORACLE_H_INCLUDED
+#define PROCESS_ORACLE_H_INCLUDED
+
+#include "test-suite-oracle.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// A long-lived test runner process, started with "/bin/sh -c command".
+// It reads one schedule per line on its stdin, the test ids separated by
+// spaces, and answers each with one line on its stdout holding a '1' for
+// every test that passed and a '0' for every test that failed, in the
+// order of the schedule. It exits at the end of its input.
+class RunnerWorker {
+public:
+  explicit RunnerWorker(const std::string &command);
+  ~RunnerWorker(void);
+
+  bool start(void);
+  void stop(void);
+  bool send(const std::string &line);
+
+  // The descriptor to poll for the answers of the runner.
+  inline int output(void) const { return out; }
+  // Reads what the runner wrote so far. Returns false once it is gone.
+  bool fill(void);
+  // Takes the next complete line of the answers, without its newline.
+  bool next_line(std::string &line);
+
+private:
+  std::string command;
+  pid_t pid;
+  int in;
+  int out;
+  std::string buffer;
+};
+
+// Runs the schedules on a pool of runner workers, forked once up front so
+// that a run costs a write and a read instead of a fork and an exec. Each
+// worker runs one schedule at a time, so the pool keeps as many schedules
+// in flight as it has workers, and waits for them with poll on the calling
+// thread. A worker that dies is restarted and given the schedule again
+// once. A schedule without an answer within the timeout counts as failing
+// from its first test, which keeps every dependency it could have
+// disproved, and its worker is restarted.
+class ProcessOracle : public TestSuiteOracle {
+public:
+  ProcessOracle(const std::string &command, const std::vector<uint32_t> &tests,
+                uint32_t workers, std::chrono::milliseconds timeout);
+  ~ProcessOracle(void) override;
+
+  std::vector<uint32_t> tests(void) const override;
+  std::vector<bool> run_tests(const std::vector<uint32_t> &tests) override;
+  uint32_t run_schedule(const ScheduleView &schedule) override;
+
+  uint32_t window(void) const override;
+  uint64_t submit(const std::vector<uint32_t> &tests) override;
+  uint64_t submit(const ScheduleView &schedule) override;
+
+protected:
+  void await(void) override;
+
+private:
+  // The schedule a worker is running.
+  class Run {
+  public:
+    uint64_t ticket;
+    std::string request;
+    uint32_t size;
+    std::chrono::steady_clock::time_point deadline;
+    bool retried;
+  };
+
+  template <class It> uint64_t start_run(It first, It last, uint32_t size);
+  uint32_t wait_for(uint64_t ticket);
+  void poll_workers(void);
+  void restart(uint32_t worker);
+  void finish(uint32_t worker, const std::string &line);
+  void time_out(uint32_t worker);
+  bool parse_results(const std::string &line, uint32_t n,
+                     std::vector<bool> &results) const;
+
+  std::string command;
+  std::vector<uint32_t> suite;
+  std::vector<std::unique_ptr<RunnerWorker>> workers;
+  // The run of each worker, empty when the worker is idle
+  std::vector<std::unique_ptr<Run>> runs;
+  std::chrono::milliseconds timeout;
+};
+
+#endif
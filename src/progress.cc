@@ -0,0 +1,106 @@
+#include "progress.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+Progress::Progress(void) : algorithm{nullptr}, names{}, values{} {}
+
+void Progress::describe(const char *algorithm, const char *first,
+                        const char *second) {
+  values[0].store(0, std::memory_order_relaxed);
+  values[1].store(0, std::memory_order_relaxed);
+  names[0].store(first, std::memory_order_relaxed);
+  names[1].store(second, std::memory_order_relaxed);
+  this->algorithm.store(algorithm, std::memory_order_release);
+}
+
+std::string Progress::report(void) const {
+  const char *name = algorithm.load(std::memory_order_acquire);
+  std::ostringstream os;
+
+  if (!name)
+    return "";
+
+  os << name;
+  for (uint32_t i = 0; i < gauges; ++i)
+    if (const char *gauge = names[i].load(std::memory_order_relaxed))
+      os << ' ' << gauge << '=' << values[i].load(std::memory_order_relaxed);
+
+  return os.str();
+}
+
+Heartbeat::Heartbeat(const Progress &progress, const TestSuiteOracle &oracle,
+                     std::chrono::milliseconds interval)
+    : progress{progress}, oracle{oracle}, interval{interval}, mutex{},
+      wake{}, stopped{false}, thread{&Heartbeat::beat, this} {}
+
+Heartbeat::~Heartbeat(void) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopped = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void Heartbeat::beat(void) {
+  auto start = std::chrono::steady_clock::now();
+  auto last = start;
+  auto next = start + interval;
+  uint64_t last_runs{0};
+  std::unique_lock<std::mutex> lock{mutex};
+
+  while (true) {
+    wake.wait_until(lock, next);
+    if (stopped)
+      break;
+    auto now = std::chrono::steady_clock::now();
+    if (now < next)
+      continue;
+    uint64_t runs = oracle.get_test_suite_runs();
+    std::string report = progress.report();
+    double seconds = std::chrono::duration<double>(now - last).count();
+    std::ostringstream os;
+
+    os << "progress: "
+       << format_duration(
+              std::chrono::duration_cast<std::chrono::seconds>(now - start))
+       << (report.empty() ? "" : " ") << report << " | " << runs
+       << " runs, " << std::fixed << std::setprecision(1)
+       << (seconds > 0 ? (runs - last_runs) / seconds : 0) << " runs/s | rss "
+       << resident_memory() / 1048576.0 << " MiB";
+    std::cerr << os.str() << std::endl;
+
+    last = now;
+    last_runs = runs;
+    next += interval;
+  }
+}
+
+uint64_t resident_memory(void) {
+  std::ifstream statm{"/proc/self/statm"};
+  uint64_t size, resident;
+
+  if (!(statm >> size >> resident))
+    return 0;
+
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::string format_duration(std::chrono::seconds duration) {
+  uint64_t seconds = duration.count();
+  std::ostringstream os;
+
+  os << std::setfill('0');
+  if (seconds >= 3600)
+    os << seconds / 3600 << 'h' << std::setw(2) << seconds / 60 % 60 << 'm'
+       << std::setw(2) << seconds % 60 << 's';
+  else if (seconds >= 60)
+    os << seconds / 60 << 'm' << std::setw(2) << seconds % 60 << 's';
+  else
+    os << seconds << 's';
+
+  return os.str();
+}
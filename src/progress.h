@@ -0,0 +1,68 @@
+#ifndef PROGRESS_H_INCLUDED
+#define PROGRESS_H_INCLUDED
+
+#include "test-suite-oracle.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Where a running algorithm stands, as up to two named gauges. A gauge is
+// written only by the thread of the algorithm, with a relaxed store, so
+// publishing costs its loops a plain store. The heartbeat reads them from
+// another thread.
+class Progress {
+public:
+  static const uint32_t gauges = 2;
+
+  explicit Progress(void);
+
+  // Names the gauges of a run before it publishes them. A null name leaves
+  // the gauge out of the reports.
+  void describe(const char *algorithm, const char *first, const char *second);
+
+  inline void publish(uint32_t gauge, uint64_t value) {
+    values[gauge].store(value, std::memory_order_relaxed);
+  }
+
+  // The gauges as "algorithm name=value...", or an empty string before a
+  // run describes them.
+  std::string report(void) const;
+
+private:
+  std::atomic<const char *> algorithm;
+  std::atomic<const char *> names[gauges];
+  std::atomic<uint64_t> values[gauges];
+};
+
+// Prints a line to stderr every interval from a thread of its own, with
+// the gauges of a run, the schedules its oracle ran and their rate, and the
+// resident memory of the process, until destroyed.
+class Heartbeat {
+public:
+  Heartbeat(const Progress &progress, const TestSuiteOracle &oracle,
+            std::chrono::milliseconds interval);
+  ~Heartbeat(void);
+
+private:
+  void beat(void);
+
+  const Progress &progress;
+  const TestSuiteOracle &oracle;
+  std::chrono::milliseconds interval;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopped;
+  std::thread thread;
+};
+
+// The resident memory of the process in bytes, or 0 if it is unknown.
+uint64_t resident_memory(void);
+
+// A duration as hours, minutes and seconds, like "1h02m03s".
+std::string format_duration(std::chrono::seconds duration);
+
+#endif
@@ -0,0 +1,164 @@
+#include "schedule-kernels.h"
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static uint32_t intersection_size_scalar(const uint32_t *a, uint32_t na,
+                                         const uint32_t *b, uint32_t nb) {
+  uint32_t i{0}, j{0}, count{0};
+
+  while (i < na && j < nb) {
+    uint32_t x = a[i], y = b[j];
+
+    count += x == y;
+    i += x <= y;
+    j += y <= x;
+  }
+
+  return count;
+}
+
+static uint32_t mismatch_scalar(const uint32_t *a, const uint32_t *b,
+                                uint32_t n) {
+  uint32_t i{0};
+
+  while (i < n && a[i] == b[i])
+    ++i;
+
+  return i;
+}
+
+#if defined(__x86_64__)
+// Compares a block of 4 ids of a against every rotation of a block of 4
+// ids of b, then moves past the block with the smallest last id. Since
+// the ids of a set are unique, every common id is counted once.
+static uint32_t intersection_size_sse2(const uint32_t *a, uint32_t na,
+                                       const uint32_t *b, uint32_t nb) {
+  uint32_t i{0}, j{0}, count{0};
+
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                     _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+        _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4e)),
+                     _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+    uint32_t amax = a[i + 3], bmax = b[j + 3];
+
+    count += std::popcount((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(eq)));
+    i += (amax <= bmax) * 4;
+    j += (bmax <= amax) * 4;
+  }
+
+  return count + intersection_size_scalar(a + i, na - i, b + j, nb - j);
+}
+
+static uint32_t mismatch_sse2(const uint32_t *a, const uint32_t *b,
+                              uint32_t n) {
+  uint32_t i{0};
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)),
+                                 _mm_loadu_si128((const __m128i *)(b + i)));
+    uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+    if (mask != 0xf)
+      return i + std::countr_zero(~mask);
+  }
+
+  return i + mismatch_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) static uint32_t
+intersection_size_avx2(const uint32_t *a, uint32_t na, const uint32_t *b,
+                       uint32_t nb) {
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  uint32_t i{0}, j{0}, count{0};
+
+  while (i + 8 <= na && j + 8 <= nb) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+    __m256i eq = _mm256_cmpeq_epi32(va, vb);
+
+    for (uint32_t r = 1; r < 8; ++r) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+    }
+
+    uint32_t amax = a[i + 7], bmax = b[j + 7];
+    count +=
+        std::popcount((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+    i += (amax <= bmax) * 8;
+    j += (bmax <= amax) * 8;
+  }
+
+  return count + intersection_size_sse2(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx2"))) static uint32_t
+mismatch_avx2(const uint32_t *a, const uint32_t *b, uint32_t n) {
+  uint32_t i{0};
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i eq =
+        _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+                           _mm256_loadu_si256((const __m256i *)(b + i)));
+    uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    if (mask != 0xff)
+      return i + std::countr_zero(~mask);
+  }
+
+  return i + mismatch_sse2(a + i, b + i, n - i);
+}
+
+static bool detect_avx2(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+static const bool has_avx2 = detect_avx2();
+
+uint32_t sorted_intersection_size(const std::vector<uint32_t> &a,
+                                  const std::vector<uint32_t> &b) {
+  if (has_avx2)
+    return intersection_size_avx2(a.data(), a.size(), b.data(), b.size());
+  return intersection_size_sse2(a.data(), a.size(), b.data(), b.size());
+}
+
+uint32_t schedule_mismatch(const uint32_t *a, const uint32_t *b, uint32_t n) {
+  if (has_avx2)
+    return mismatch_avx2(a, b, n);
+  return mismatch_sse2(a, b, n);
+}
+#else
+uint32_t sorted_intersection_size(const std::vector<uint32_t> &a,
+                                  const std::vector<uint32_t> &b) {
+  return intersection_size_scalar(a.data(), a.size(), b.data(), b.size());
+}
+
+uint32_t schedule_mismatch(const uint32_t *a, const uint32_t *b, uint32_t n) {
+  return mismatch_scalar(a, b, n);
+}
+#endif
+
+void sorted_union(const std::vector<uint32_t> &a,
+                  const std::vector<uint32_t> &b, std::vector<uint32_t> &out) {
+  uint32_t i{0}, j{0}, k{0};
+
+  out.resize(a.size() + b.size());
+  while (i < a.size() && j < b.size()) {
+    uint32_t x = a[i], y = b[j];
+
+    out[k++] = x < y ? x : y;
+    i += x <= y;
+    j += y <= x;
+  }
+  while (i < a.size())
+    out[k++] = a[i++];
+  while (j < b.size())
+    out[k++] = b[j++];
+  out.resize(k);
+}
@@ -0,0 +1,55 @@
+#ifndef SCHEDULE_KERNELS_H_INCLUDED
+#define SCHEDULE_KERNELS_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+// Kernels on schedules kept as sorted sets of test ids. On x86-64 they use
+// SSE2, which every x86-64 CPU has, or AVX2 when the CPU supports it, as
+// detected at startup. Other targets get the scalar versions.
+
+// The number of ids in both a and b.
+uint32_t sorted_intersection_size(const std::vector<uint32_t> &a,
+                                  const std::vector<uint32_t> &b);
+
+// Whether the union of a and b has at most limit ids, without building it.
+inline bool sorted_union_fits(const std::vector<uint32_t> &a,
+                              const std::vector<uint32_t> &b, uint32_t limit) {
+  if (a.size() > limit || b.size() > limit)
+    return false;
+  if (a.size() + b.size() <= limit)
+    return true;
+  return a.size() + b.size() - sorted_intersection_size(a, b) <= limit;
+}
+
+// Stores the union of a and b into out, reusing its storage.
+void sorted_union(const std::vector<uint32_t> &a,
+                  const std::vector<uint32_t> &b, std::vector<uint32_t> &out);
+
+// The first index where a and b differ, or n if their first n ids match.
+uint32_t schedule_mismatch(const uint32_t *a, const uint32_t *b, uint32_t n);
+
+// Schedules shorter than this are compared inline: below two AVX2 blocks
+// the call to the kernel costs more than the loop it replaces.
+static const uint32_t schedule_mismatch_min = 16;
+
+// Orders schedules like std::less, comparing the common prefix of long
+// schedules with the mismatch kernel.
+class ScheduleLess {
+public:
+  inline bool operator()(const std::vector<uint32_t> &a,
+                         const std::vector<uint32_t> &b) const {
+    uint32_t n = a.size() < b.size() ? a.size() : b.size();
+    uint32_t k{0};
+
+    if (n >= schedule_mismatch_min)
+      k = schedule_mismatch(a.data(), b.data(), n);
+    else
+      while (k < n && a[k] == b[k])
+        ++k;
+
+    return k < n ? a[k] < b[k] : a.size() < b.size();
+  }
+};
+
+#endif
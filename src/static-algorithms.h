@@ -0,0 +1,196 @@
+#ifndef STATIC_ALGORITHMS_H_INCLUDED
+#define STATIC_ALGORITHMS_H_INCLUDED
+
+#include "algorithms.h"
+#include "graph.h"
+#include "test-suite-oracle.h"
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// PFAST, PraDet and MEMFAST instantiated at compile time for suites of at
+// most N tests. The dependency graph is then a N x N bit matrix whose rows
+// are copied and merged without allocating, and the oracle is asked
+// through its concrete type when it is a DirectDependenciesOracle.
+
+template <uint32_t N> class FixedBitset {
+public:
+  static constexpr uint32_t words = N / 64;
+
+  FixedBitset(void) : w{} {}
+
+  inline void set(uint32_t i) { w[i >> 6] |= (uint64_t)1 << (i & 63); }
+  inline void reset(uint32_t i) { w[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+  inline bool test(uint32_t i) const { return (w[i >> 6] >> (i & 63)) & 1; }
+
+  inline bool any(void) const {
+    for (uint32_t k = 0; k < words; ++k)
+      if (w[k])
+        return true;
+    return false;
+  }
+
+  // The k-th word of the bits, like the rows of a BitMatrix.
+  inline uint64_t operator[](uint32_t k) const { return w[k]; }
+
+  // The first set bit at or after i, or N if there is none.
+  inline uint32_t next(uint32_t i) const {
+    if (i >= N)
+      return N;
+
+    uint32_t k = i >> 6;
+    uint64_t x = w[k] & (~(uint64_t)0 << (i & 63));
+    while (!x) {
+      if (++k == words)
+        return N;
+      x = w[k];
+    }
+
+    return (k << 6) + std::countr_zero(x);
+  }
+
+  inline FixedBitset &operator|=(const FixedBitset &other) {
+    for (uint32_t k = 0; k < words; ++k)
+      w[k] |= other.w[k];
+    return *this;
+  }
+
+  inline FixedBitset &remove(const FixedBitset &other) {
+    for (uint32_t k = 0; k < words; ++k)
+      w[k] &= ~other.w[k];
+    return *this;
+  }
+
+private:
+  std::array<uint64_t, words> w;
+};
+
+template <uint32_t N> class BitsetGraph {
+public:
+  typedef FixedBitset<N> Row;
+
+  explicit BitsetGraph(uint32_t n) : rows(n) {}
+
+  inline uint32_t size(void) const { return rows.size(); }
+  inline void add_edge(uint32_t u, uint32_t v) { rows[u].set(v); }
+  inline void remove_edge(uint32_t u, uint32_t v) { rows[u].reset(v); }
+
+  inline void invert_edge(uint32_t u, uint32_t v) {
+    remove_edge(u, v);
+    add_edge(v, u);
+  }
+
+  // Same semantics as Graph::get_dependencies: u is part of its own
+  // dependencies only if it is on a cycle.
+  Row dependencies(uint32_t u) const {
+    Row deps{};
+    Row frontier{rows[u]};
+
+    while (frontier.any()) {
+      Row next{};
+
+      deps |= frontier;
+      for (uint32_t v = frontier.next(0); v < N; v = frontier.next(v + 1))
+        next |= rows[v];
+      frontier = next.remove(deps);
+    }
+
+    return deps;
+  }
+
+  inline void dependencies(uint32_t u, Row &deps) const {
+    deps = dependencies(u);
+  }
+
+  void transitive_reduction(void) {
+    std::vector<Row> deps(rows.size());
+
+    for (uint32_t u = 0; u < rows.size(); ++u)
+      deps[u] = dependencies(u);
+
+    for (auto &row : rows) {
+      Row redundant{};
+
+      for (uint32_t v = row.next(0); v < N; v = row.next(v + 1))
+        redundant |= deps[v];
+      row.remove(redundant);
+    }
+  }
+
+  Graph to_graph(const std::vector<uint32_t> &tests) const {
+    Graph g{tests};
+
+    for (uint32_t u = 0; u < rows.size(); ++u)
+      for (uint32_t v = rows[u].next(0); v < N; v = rows[u].next(v + 1))
+        g.add_edge(tests[u], tests[v]);
+
+    return g;
+  }
+
+private:
+  std::vector<Row> rows;
+};
+
+// Runs the algorithm A on a BitsetGraph of N tests. Larger suites are
+// handed to the dynamic implementation.
+template <template <class, class> class A, uint32_t N>
+class SpecializedAlgorithm : public Algorithm {
+public:
+  explicit SpecializedAlgorithm(std::unique_ptr<Algorithm> &&dynamic)
+      : dynamic{std::move(dynamic)}, direct{}, generic{}, last{nullptr} {}
+
+  std::unique_ptr<Graph> run(const std::vector<uint32_t> &tests,
+                             TestSuiteOracle *oracle) override {
+    if (tests.size() > N)
+      return forward(*dynamic, tests, oracle);
+    else if (dynamic_cast<DirectDependenciesOracle *>(oracle))
+      return forward(direct, tests, oracle);
+    return forward(generic, tests, oracle);
+  }
+
+  void add_metrics(MetricsRow &row) const override {
+    if (last)
+      last->add_metrics(row);
+  }
+
+private:
+  std::unique_ptr<Graph> forward(Algorithm &algo,
+                                 const std::vector<uint32_t> &tests,
+                                 TestSuiteOracle *oracle) {
+    algo.set_checkpointer(checkpointer);
+    algo.set_progress(progress);
+    std::unique_ptr<Graph> r{algo.run(tests, oracle)};
+    truncated = algo.is_truncated();
+    last = &algo;
+    return r;
+  }
+
+  std::unique_ptr<Algorithm> dynamic;
+  A<BitsetGraph<N>, DirectDependenciesOracle> direct;
+  A<BitsetGraph<N>, TestSuiteOracle> generic;
+  // The instance that ran last, for its metrics
+  Algorithm *last;
+};
+
+// Picks the smallest instantiation the suite fits into, or the dynamic
+// implementation for larger suites.
+template <template <class, class> class A>
+std::unique_ptr<Algorithm> specialize(uint32_t tests,
+                                      std::unique_ptr<Algorithm> &&dynamic) {
+  if (tests <= 64)
+    return std::make_unique<SpecializedAlgorithm<A, 64>>(std::move(dynamic));
+  else if (tests <= 128)
+    return std::make_unique<SpecializedAlgorithm<A, 128>>(std::move(dynamic));
+  else if (tests <= 256)
+    return std::make_unique<SpecializedAlgorithm<A, 256>>(std::move(dynamic));
+  else if (tests <= 512)
+    return std::make_unique<SpecializedAlgorithm<A, 512>>(std::move(dynamic));
+  else if (tests <= 1024)
+    return std::make_unique<SpecializedAlgorithm<A, 1024>>(
+        std::move(dynamic));
+  return std::move(dynamic);
+}
+
+#endif
@@ -1,7 +1,129 @@
 #include "test-suite-oracle.h"
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
+OracleBudget::OracleBudget(void)
+    : max_test_suite_runs{0}, max_test_runs{0}, time_limit{0} {}
+
+ScheduleView::Iterator::Iterator(const ScheduleView &view, uint32_t pos)
+    : view{&view}, pos{pos}, hole{0} {
+  while (hole < view.holes.size() && view.holes[hole] < pos)
+    ++hole;
+  skip_holes();
+}
+
+ScheduleView::Iterator &ScheduleView::Iterator::operator++(void) {
+  ++pos;
+  skip_holes();
+  return *this;
+}
+
+void ScheduleView::Iterator::skip_holes(void) {
+  while (hole < view->holes.size() && view->holes[hole] == pos) {
+    ++pos;
+    ++hole;
+  }
+}
+
+ScheduleView::ScheduleView(const std::vector<uint32_t> &base)
+    : base{&base}, holes{} {}
+
+void ScheduleView::exclude(uint32_t pos) {
+  auto it = std::lower_bound(holes.begin(), holes.end(), pos);
+  if (it == holes.end() || *it != pos)
+    holes.insert(it, pos);
+}
+
+uint32_t ScheduleView::position(uint32_t k) const {
+  uint32_t pos{k};
+
+  for (const uint32_t hole : holes)
+    if (hole <= pos)
+      ++pos;
+    else
+      break;
+
+  return pos;
+}
+
+TestSuiteOracle::TestSuiteOracle(void)
+    : test_suite_runs{0}, test_runs{0}, next_ticket{0}, finished{}, budget{},
+      start{std::chrono::steady_clock::now()} {}
+
+uint32_t TestSuiteOracle::window(void) const { return 1; }
+
+uint32_t TestSuiteOracle::run_schedule(const ScheduleView &schedule) {
+  std::vector<uint32_t> tests;
+
+  tests.reserve(schedule.size());
+  for (const uint32_t test : schedule)
+    tests.push_back(test);
+
+  std::vector<bool> results{run_tests(tests)};
+
+  return std::find(results.begin(), results.end(), false) - results.begin();
+}
+
+uint64_t TestSuiteOracle::submit(const std::vector<uint32_t> &tests) {
+  std::vector<bool> results{run_tests(tests)};
+  uint32_t passed =
+      std::find(results.begin(), results.end(), false) - results.begin();
+
+  finished.push_back(Finished{next_ticket, passed, (uint32_t)tests.size()});
+  return next_ticket++;
+}
+
+uint64_t TestSuiteOracle::submit(const ScheduleView &schedule) {
+  finished.push_back(
+      Finished{next_ticket, run_schedule(schedule), schedule.size()});
+  return next_ticket++;
+}
+
+uint64_t TestSuiteOracle::wait(std::vector<bool> &results) {
+  await();
+
+  Finished run{finished.front()};
+  finished.pop_front();
+  results.assign(run.size, false);
+  std::fill(results.begin(), results.begin() + run.passed, true);
+
+  return run.ticket;
+}
+
+uint64_t TestSuiteOracle::wait(uint32_t &passed) {
+  await();
+
+  Finished run{finished.front()};
+  finished.pop_front();
+  passed = run.passed;
+
+  return run.ticket;
+}
+
+void TestSuiteOracle::await(void) {}
+
+void TestSuiteOracle::set_budget(const OracleBudget &budget) {
+  this->budget = budget;
+  start = std::chrono::steady_clock::now();
+}
+
+bool TestSuiteOracle::exhausted(void) const {
+  if (budget.max_test_suite_runs &&
+      test_suite_runs >= budget.max_test_suite_runs)
+    return true;
+  if (budget.max_test_runs && test_runs >= budget.max_test_runs)
+    return true;
+
+  return budget.time_limit.count() &&
+         std::chrono::steady_clock::now() - start >= budget.time_limit;
+}
+
+bool TestSuiteOracle::has_budget(void) const {
+  return budget.max_test_suite_runs || budget.max_test_runs ||
+         budget.time_limit.count();
+}
+
 DirectDependenciesOracle::DirectDependenciesOracle(
     const std::vector<uint32_t> &nodes, const GraphGeneratorParams &params)
     : graph{nodes} {
@@ -20,38 +142,65 @@ DirectDependenciesOracle::DirectDependenciesOracle(
     exit(EXIT_FAILURE);
   }
   graph_generator->generate_edges();
+  index_graph();
 }
 
 DirectDependenciesOracle::DirectDependenciesOracle(const Graph &g)
-    : graph{g}, test_suite_runs{0}, test_runs{0} {}
+    : graph{g} {
+  index_graph();
+}
+
+void DirectDependenciesOracle::index_graph(void) {
+  for (const auto &it : graph)
+    positions.emplace(it.first, positions.size());
+  direct = PositionGraph{graph, positions};
+  passed.assign((positions.size() + 63) / 64, 0);
+}
 
 std::vector<bool>
 DirectDependenciesOracle::run_tests(const std::vector<uint32_t> &tests) {
   std::vector<bool> results(tests.size(), false);
 
+  std::fill(results.begin(),
+            results.begin() + passing_prefix(tests.begin(), tests.end()),
+            true);
+
+  return results;
+}
+
+uint32_t DirectDependenciesOracle::run_schedule(const ScheduleView &schedule) {
+  return passing_prefix(schedule.begin(), schedule.end());
+}
+
+// A test passes when its dependencies ran before it. Every test before the
+// one running passed, so they had their own dependencies, and checking the
+// direct dependencies of a test among them checks all of its dependencies,
+// without walking them.
+template <class It>
+uint32_t DirectDependenciesOracle::passing_prefix(It first, It last) {
+  uint32_t i{0};
+
   ++test_suite_runs;
+  std::fill(passed.begin(), passed.end(), 0);
 
-  for (uint32_t i = 0; i < tests.size(); ++i) {
-    std::unordered_set<uint32_t> deps = graph.get_dependencies(tests[i]);
+  for (; first != last; ++first, ++i) {
+    uint32_t u = positions.find(*first)->second;
 
-    for (const uint32_t dep : deps) {
-      bool satisfied{false};
-      for (uint32_t j = 0; j != i; ++j)
-        if (tests[j] == dep)
-          satisfied = true;
+    for (uint32_t k = direct.offsets[u]; k < direct.offsets[u + 1]; ++k) {
+      uint32_t v = direct.deps[k];
 
-      if (!satisfied) {
+      if (!(passed[v >> 6] >> (v & 63) & 1)) {
         test_runs += i + 1;
-        return results;
+        return i;
       }
     }
 
-    results[i] = true;
+    passed[u >> 6] |= (uint64_t)1 << (u & 63);
   }
 
-  test_runs += tests.size();
+  test_runs += i;
 
-  return results;
+  return i;
 }
 
 std::vector<uint32_t> DirectDependenciesOracle::tests(void) const {
@@ -2,14 +2,126 @@
 #define TEST_SUITE_ORACLE_H_INCLUDED
 
 #include "graph.h"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+// Limits on the work an oracle may do. A zero value means no limit.
+class OracleBudget {
+public:
+  explicit OracleBudget(void);
+
+  uint64_t max_test_suite_runs;
+  uint64_t max_test_runs;
+  std::chrono::milliseconds time_limit;
+};
+
+// A schedule made of a base sequence of tests with some of its positions
+// left out. Leaving a test out keeps the others in place, so a schedule
+// that shrinks one test at a time costs no copy of the tests. The base must
+// outlive the view.
+class ScheduleView {
+public:
+  class Iterator {
+  public:
+    Iterator(const ScheduleView &view, uint32_t pos);
+
+    inline uint32_t operator*(void) const { return (*view->base)[pos]; }
+    inline bool operator!=(const Iterator &other) const {
+      return pos != other.pos;
+    }
+    Iterator &operator++(void);
+
+  private:
+    void skip_holes(void);
+
+    const ScheduleView *view;
+    uint32_t pos;
+    uint32_t hole;
+  };
+
+  explicit ScheduleView(const std::vector<uint32_t> &base);
+
+  // Leaves out the test at the given position of the base.
+  void exclude(uint32_t pos);
+  // The position in the base of the k-th test of the schedule.
+  uint32_t position(uint32_t k) const;
+
+  inline uint32_t size(void) const { return base->size() - holes.size(); }
+  inline Iterator begin(void) const { return Iterator{*this, 0}; }
+  inline Iterator end(void) const {
+    return Iterator{*this, (uint32_t)base->size()};
+  }
+
+private:
+  const std::vector<uint32_t> *base;
+  // The positions left out, sorted
+  std::vector<uint32_t> holes;
+};
+
 class TestSuiteOracle {
 public:
+  TestSuiteOracle(void);
   virtual ~TestSuiteOracle(void) {}
   virtual std::vector<bool> run_tests(const std::vector<uint32_t> &tests) = 0;
   virtual std::vector<uint32_t> tests(void) const = 0;
+  // Runs the schedule of a view and returns the number of tests passing at
+  // its start, after which every test fails. The default implementation
+  // copies the view for run_tests.
+  virtual uint32_t run_schedule(const ScheduleView &schedule);
+
+  // Up to window() schedules can be in flight at once: submit starts one
+  // and returns its ticket, and wait blocks until one of the submitted
+  // schedules finishes, returning its ticket and storing its results, or
+  // the number of tests passing at its start. The default implementation
+  // runs each schedule in submit, so that every oracle works with the
+  // algorithms that keep schedules in flight.
+  virtual uint32_t window(void) const;
+  virtual uint64_t submit(const std::vector<uint32_t> &tests);
+  virtual uint64_t submit(const ScheduleView &schedule);
+  uint64_t wait(std::vector<bool> &results);
+  uint64_t wait(uint32_t &passed);
+
+  // The algorithms stop issuing schedules once the budget is exhausted, so
+  // the test runs can exceed their limit by at most one schedule.
+  void set_budget(const OracleBudget &budget);
+  bool exhausted(void) const;
+  bool has_budget(void) const;
+
+  inline uint64_t get_test_suite_runs(void) const { return test_suite_runs; }
+  inline uint64_t get_test_runs(void) const { return test_runs; }
+  inline void restore_counters(uint64_t suite_runs, uint64_t runs) {
+    test_suite_runs = suite_runs;
+    test_runs = runs;
+  }
+
+protected:
+  // A run that finished but was not waited for yet, with the number of
+  // tests passing at its start and the number of tests it had.
+  class Finished {
+  public:
+    uint64_t ticket;
+    uint32_t passed;
+    uint32_t size;
+  };
+
+  // Blocks until some run finished. The default implementation never
+  // blocks, since submit runs each schedule right away.
+  virtual void await(void);
+
+  // Atomic so that a heartbeat can read them while the algorithm runs
+  std::atomic<uint64_t> test_suite_runs;
+  std::atomic<uint64_t> test_runs;
+  uint64_t next_ticket;
+  std::deque<Finished> finished;
+
+private:
+  OracleBudget budget;
+  std::chrono::steady_clock::time_point start;
 };
 
 class GraphGeneratorParams {
@@ -20,7 +132,7 @@ public:
   uint32_t max_out;
 };
 
-class DirectDependenciesOracle : public TestSuiteOracle {
+class DirectDependenciesOracle final : public TestSuiteOracle {
 public:
   DirectDependenciesOracle(const std::vector<uint32_t> &nodes,
                            const GraphGeneratorParams &params);
@@ -29,14 +141,18 @@ public:
 
   std::vector<uint32_t> tests(void) const override;
   std::vector<bool> run_tests(const std::vector<uint32_t> &tests) override;
+  uint32_t run_schedule(const ScheduleView &schedule) override;
   inline const Graph &get_graph(void) const { return graph; }
-  inline uint64_t get_test_suite_runs(void) const { return test_suite_runs; }
-  inline uint64_t get_test_runs(void) const { return test_runs; }
 
 private:
+  void index_graph(void);
+  template <class It> uint32_t passing_prefix(It first, It last);
+
   Graph graph;
-  uint64_t test_suite_runs;
-  uint64_t test_runs;
+  std::unordered_map<uint32_t, uint32_t> positions;
+  PositionGraph direct;
+  // One bit per position, set for the tests that passed in the current run
+  std::vector<uint64_t> passed;
 };
 
 #endif
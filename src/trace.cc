@@ -0,0 +1,162 @@
+#include "trace.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+static const char trace_magic[] = "STST";
+static const uint64_t trace_version = 1;
+// The bytes of records kept in memory before they are written out
+static const size_t trace_buffer_bytes = (size_t)1 << 20;
+
+TraceWriter::TraceWriter(const std::string &file,
+                         const std::vector<uint32_t> &tests)
+    : file{file}, out{file, std::ios::binary | std::ios::trunc}, buf{},
+      prev{} {
+  if (!out) {
+    std::cerr << "Could not open trace file \"" << file << '"' << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  buf.put(std::string{trace_magic});
+  buf.put(trace_version);
+  buf.put(tests);
+}
+
+TraceWriter::~TraceWriter(void) { flush(); }
+
+template <class S>
+void TraceWriter::record(const S &schedule, uint32_t passed) {
+  buf.put_schedule(schedule, prev);
+  buf.put(passed);
+
+  prev.clear();
+  for (const uint32_t test : schedule)
+    prev.push_back(test);
+
+  if (buf.data().size() >= trace_buffer_bytes)
+    flush();
+}
+
+template void TraceWriter::record(const std::vector<uint32_t> &schedule,
+                                  uint32_t passed);
+template void TraceWriter::record(const ScheduleView &schedule,
+                                  uint32_t passed);
+
+void TraceWriter::flush(void) {
+  out.write(buf.data().data(), buf.data().size());
+  out.flush();
+  buf.clear();
+  if (!out) {
+    std::cerr << "Failed to write trace file \"" << file << '"' << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+TraceReader::TraceReader(const std::string &file)
+    : file{file}, reader{}, suite{} {
+  std::ifstream is{file, std::ios::binary};
+  if (!is) {
+    std::cerr << "Could not open trace file \"" << file << '"' << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  reader.reset(new CheckpointReader{std::string{
+      std::istreambuf_iterator<char>{is}, std::istreambuf_iterator<char>{}}});
+  if (reader->get_string() != trace_magic ||
+      reader->get() != trace_version) {
+    std::cerr << '"' << file << '"' << " is not a valid trace file."
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  suite = reader->get_vector();
+}
+
+bool TraceReader::next(std::vector<uint32_t> &schedule, uint32_t &passed) {
+  if (reader->at_end())
+    return false;
+
+  reader->get_schedule(schedule);
+  passed = reader->get();
+  if (!reader->ok() || passed > schedule.size()) {
+    std::cerr << "The trace file \"" << file << '"' << " is truncated."
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  return true;
+}
+
+TracingOracle::TracingOracle(std::unique_ptr<TestSuiteOracle> &&inner,
+                             const std::string &file)
+    : inner{std::move(inner)}, trace{file, this->inner->tests()}, pending{},
+      seen_suite_runs{this->inner->get_test_suite_runs()},
+      seen_runs{this->inner->get_test_runs()} {}
+
+std::vector<uint32_t> TracingOracle::tests(void) const {
+  return inner->tests();
+}
+
+std::vector<bool>
+TracingOracle::run_tests(const std::vector<uint32_t> &tests) {
+  std::vector<bool> results{inner->run_tests(tests)};
+
+  follow_counters();
+  trace.record(tests, std::find(results.begin(), results.end(), false) -
+                          results.begin());
+
+  return results;
+}
+
+uint32_t TracingOracle::run_schedule(const ScheduleView &schedule) {
+  uint32_t passed = inner->run_schedule(schedule);
+
+  follow_counters();
+  trace.record(schedule, passed);
+
+  return passed;
+}
+
+uint32_t TracingOracle::window(void) const { return inner->window(); }
+
+uint64_t TracingOracle::submit(const std::vector<uint32_t> &tests) {
+  uint64_t ticket = inner->submit(tests);
+
+  follow_counters();
+  pending[ticket] = tests;
+
+  return ticket;
+}
+
+uint64_t TracingOracle::submit(const ScheduleView &schedule) {
+  uint64_t ticket = inner->submit(schedule);
+  std::vector<uint32_t> &tests = pending[ticket];
+
+  follow_counters();
+  for (const uint32_t test : schedule)
+    tests.push_back(test);
+
+  return ticket;
+}
+
+void TracingOracle::await(void) {
+  if (!finished.empty())
+    return;
+
+  uint32_t passed;
+  uint64_t ticket = inner->wait(passed);
+  auto it = pending.find(ticket);
+
+  follow_counters();
+  trace.record(it->second, passed);
+  finished.push_back(Finished{ticket, passed, (uint32_t)it->second.size()});
+  pending.erase(it);
+}
+
+// Adds what the other oracle counted since the last call, so that counters
+// restored from a checkpoint carry over.
+void TracingOracle::follow_counters(void) {
+  test_suite_runs += inner->get_test_suite_runs() - seen_suite_runs;
+  test_runs += inner->get_test_runs() - seen_runs;
+  seen_suite_runs = inner->get_test_suite_runs();
+  seen_runs = inner->get_test_runs();
+}
@@ -0,0 +1,78 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include "checkpoint.h"
+#include "test-suite-oracle.h"
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Writes the schedules run by an oracle into a trace file, with the
+// number of tests passing at the start of each. The file holds a header
+// with the tests of the suite, then one record per run in the order the
+// runs finished: the schedule as the length of the prefix it shares with
+// the previous one plus the deltas of its remaining tests, and the number
+// of passing tests, all as varints.
+class TraceWriter {
+public:
+  TraceWriter(const std::string &file, const std::vector<uint32_t> &tests);
+  ~TraceWriter(void);
+
+  template <class S> void record(const S &schedule, uint32_t passed);
+
+private:
+  void flush(void);
+
+  std::string file;
+  std::ofstream out;
+  CheckpointWriter buf;
+  std::vector<uint32_t> prev;
+};
+
+class TraceReader {
+public:
+  explicit TraceReader(const std::string &file);
+
+  inline const std::vector<uint32_t> &tests(void) const { return suite; }
+  // Reads the next run of the trace. Returns false at its end.
+  bool next(std::vector<uint32_t> &schedule, uint32_t &passed);
+
+private:
+  std::string file;
+  std::unique_ptr<CheckpointReader> reader;
+  std::vector<uint32_t> suite;
+};
+
+// Runs the schedules on another oracle, recording each of them into a
+// trace. Its counters follow the ones of the other oracle.
+class TracingOracle : public TestSuiteOracle {
+public:
+  TracingOracle(std::unique_ptr<TestSuiteOracle> &&inner,
+                const std::string &file);
+
+  std::vector<uint32_t> tests(void) const override;
+  std::vector<bool> run_tests(const std::vector<uint32_t> &tests) override;
+  uint32_t run_schedule(const ScheduleView &schedule) override;
+
+  uint32_t window(void) const override;
+  uint64_t submit(const std::vector<uint32_t> &tests) override;
+  uint64_t submit(const ScheduleView &schedule) override;
+
+protected:
+  void await(void) override;
+
+private:
+  void follow_counters(void);
+
+  std::unique_ptr<TestSuiteOracle> inner;
+  TraceWriter trace;
+  // The schedules submitted to the other oracle, by ticket
+  std::map<uint64_t, std::vector<uint32_t>> pending;
+  uint64_t seen_suite_runs;
+  uint64_t seen_runs;
+};
+
+#endif